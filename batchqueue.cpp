@@ -0,0 +1,104 @@
+#include "batchqueue.hpp"
+
+/**
+ * @brief Construct a new BatchQueue::BatchQueue object and allocates all buffers
+ *
+ * @param[in] num_buffers number of batches in the ring (at least 2)
+ * @param[in] batch_size max number of samples per batch
+ * @param[in] num_inputs number of input values per sample
+ * @param[in] num_outputs number of reference values per sample
+ */
+BatchQueue::BatchQueue(const std::size_t num_buffers,
+                       const std::size_t batch_size,
+                       const std::size_t num_inputs,
+                       const std::size_t num_outputs)
+{
+    this->buffers_.resize(num_buffers < 2 ? 2 : num_buffers);
+    for (auto &batch : this->buffers_)
+    {
+        batch.x.resize(batch_size * num_inputs, 0.0);
+        batch.y.resize(batch_size * num_outputs, 0.0);
+    }
+}
+
+/**
+ * @brief returns the next free batch, blocks while all batches are filled
+ *
+ * @return Batch& batch owned by the producer until publish()
+ */
+BatchQueue::Batch &BatchQueue::acquire_free(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    if (this->num_filled_ == this->buffers_.size())
+    {
+        this->producer_waits_++;
+        this->not_full_.wait(lock, [this]
+                             { return this->num_filled_ < this->buffers_.size(); });
+    }
+    return this->buffers_[this->write_index_];
+}
+
+/**
+ * @brief hands the batch from acquire_free() over to the consumer
+ *
+ */
+void BatchQueue::publish(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->write_index_ = (this->write_index_ + 1) % this->buffers_.size();
+        this->num_filled_++;
+    }
+    this->not_empty_.notify_one();
+}
+
+/**
+ * @brief returns the oldest filled batch, blocks while no batch is filled
+ *
+ * @return Batch& batch owned by the consumer until release()
+ */
+BatchQueue::Batch &BatchQueue::acquire_filled(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    if (this->num_filled_ == 0)
+    {
+        this->consumer_waits_++;
+        this->not_empty_.wait(lock, [this]
+                              { return this->num_filled_ > 0; });
+    }
+    return this->buffers_[this->read_index_];
+}
+
+/**
+ * @brief hands the batch from acquire_filled() back to the producer
+ *
+ */
+void BatchQueue::release(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->read_index_ = (this->read_index_ + 1) % this->buffers_.size();
+        this->num_filled_--;
+    }
+    this->not_full_.notify_one();
+}
+
+/**
+ * @brief returns how many times the producer had to wait for a free batch
+ *
+ * @return std::size_t
+ */
+std::size_t BatchQueue::producer_waits(void) const
+{
+    return this->producer_waits_;
+}
+
+/**
+ * @brief returns how many times the consumer had to wait for data
+ *
+ * @return std::size_t
+ */
+std::size_t BatchQueue::consumer_waits(void) const
+{
+    return this->consumer_waits_;
+}
@@ -0,0 +1,55 @@
+#ifndef BATCHQUEUE_HPP_
+#define BATCHQUEUE_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief Class for a ring of preallocated training batches shared by one
+ *        producer thread and one consumer thread.
+ * @details the producer fills a free batch while the consumer trains on a
+ *          filled one. All buffers are allocated once in the constructor, a
+ *          batch is handed back and forth by index so nothing is copied or
+ *          allocated when the buffers are swapped.
+ *
+ *          producer: acquire_free() -> fill -> publish()
+ *          consumer: acquire_filled() -> train -> release()
+ */
+class BatchQueue
+{
+public:
+    struct Batch
+    {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::size_t num_samples = 0;
+        bool end = false;
+    };
+
+    BatchQueue(const std::size_t num_buffers,
+               const std::size_t batch_size,
+               const std::size_t num_inputs,
+               const std::size_t num_outputs);
+    ~BatchQueue() {}
+    Batch &acquire_free(void);
+    void publish(void);
+    Batch &acquire_filled(void);
+    void release(void);
+    std::size_t producer_waits(void) const;
+    std::size_t consumer_waits(void) const;
+
+private:
+    std::vector<Batch> buffers_;
+    std::size_t write_index_ = 0;
+    std::size_t read_index_ = 0;
+    std::size_t num_filled_ = 0;
+    std::size_t producer_waits_ = 0;
+    std::size_t consumer_waits_ = 0;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+#endif /* BATCHQUEUE_HPP_ */
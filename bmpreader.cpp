@@ -0,0 +1,97 @@
+#include "bmpreader.hpp"
+#include "convlayer.hpp"
+#include <algorithm>
+
+/**
+ * @brief opens a bitmap and checks its header, no pixels are read yet
+ *
+ * @param[in] filename path to the bitmap
+ * @param[in] band_rows number of rows read from the file at a time (min 1)
+ * @return int 0 if no errors, otherwise the error of ConvLayer::check_bmp_header
+ */
+int BmpReader::open(const char *filename, const std::size_t band_rows)
+{
+    this->file_.close();
+    this->file_.clear();
+    this->file_.open(filename, std::ios::binary);
+    if (!this->file_.is_open())
+    {
+        return 1;
+    }
+    this->file_.seekg(0, std::ios::end);
+    const std::size_t file_size = this->file_.tellg();
+    char header[SIZE_OF_HEADER] = {};
+    this->file_.seekg(0, std::ios::beg);
+    this->file_.read(header, file_size < SIZE_OF_HEADER ? file_size : SIZE_OF_HEADER);
+
+    uint32_t x_width = 0;
+    uint32_t y_height = 0;
+    int ret = ConvLayer::check_bmp_header(header, file_size, x_width, y_height, this->row_bytes_);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    this->width_ = x_width;
+    this->height_ = y_height;
+    this->band_rows_ = band_rows == 0 ? 1 : band_rows;
+    this->next_row_ = 0;
+    this->band_first_ = 0;
+    this->band_size_ = 0;
+    this->band_.clear();
+    return 0;
+}
+
+/**
+ * @brief converts the next row (top to bottom) to grey pixels
+ *
+ * @param[out] pixels width() bytes
+ * @return true if a row was read, false after the last row or on a read error
+ */
+bool BmpReader::read_row(uint8_t *pixels)
+{
+    if (this->next_row_ >= this->band_first_ + this->band_size_ && !this->read_band())
+    {
+        return false;
+    }
+    // the band holds rows band_first_ .. band_first_ + band_size_ - 1 bottom up
+    const std::size_t index = this->band_first_ + this->band_size_ - 1 - this->next_row_;
+    ConvLayer::grey_row(&this->band_[index * this->row_bytes_], this->width_, pixels);
+    this->next_row_++;
+    return true;
+}
+
+/**
+ * @brief returns the bytes of the band buffer
+ *
+ * @return std::size_t
+ */
+std::size_t BmpReader::memory_usage(void) const
+{
+    return this->band_.capacity();
+}
+
+/**
+ * @brief reads the band starting at next_row_
+ *
+ * @return true if no errors
+ */
+bool BmpReader::read_band(void)
+{
+    if (this->next_row_ >= this->height_)
+    {
+        return false;
+    }
+    const std::size_t rows = std::min(this->band_rows_, this->height_ - this->next_row_);
+    // top row y is file row height - 1 - y, the band ends at the file row of next_row_
+    const std::size_t first_file_row = this->height_ - this->next_row_ - rows;
+    this->band_.resize(rows * this->row_bytes_);
+    this->file_.seekg(SIZE_OF_HEADER + first_file_row * this->row_bytes_, std::ios::beg);
+    this->file_.read(this->band_.data(), this->band_.size());
+    if (!this->file_)
+    {
+        return false;
+    }
+    this->band_first_ = this->next_row_;
+    this->band_size_ = rows;
+    return true;
+}
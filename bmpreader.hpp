@@ -0,0 +1,46 @@
+#ifndef BMPREADER_HPP_
+#define BMPREADER_HPP_
+
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+/**
+ * @brief Class for reading a 24-bit bitmap row by row without loading the file.
+ * @details rows are returned top to bottom as grey pixels (rgb average rounded
+ *          down, as ConvLayer::import_image_from_memory with a FeatureMap).
+ *          The file stores the rows bottom up, so the rows of a band are one
+ *          contiguous block ending where the previous band started. A band of
+ *          band_rows rows is read with a single read, only that block and
+ *          no other part of the image is kept in memory.
+ *
+ * @param[in] filename path to the bitmap
+ * @param[in] band_rows number of rows read from the file at a time
+ */
+class BmpReader
+{
+public:
+    BmpReader(void) {}
+    ~BmpReader() {}
+    int open(const char *filename, const std::size_t band_rows = 16);
+    bool read_row(uint8_t *pixels);
+    std::size_t height(void) const { return this->height_; }
+    std::size_t width(void) const { return this->width_; }
+    std::size_t next_row(void) const { return this->next_row_; }
+    std::size_t memory_usage(void) const;
+
+private:
+    std::ifstream file_;
+    std::size_t height_ = 0;
+    std::size_t width_ = 0;
+    std::size_t row_bytes_ = 0;
+    std::size_t band_rows_ = 0;
+    std::size_t next_row_ = 0;
+    std::size_t band_first_ = 0;
+    std::size_t band_size_ = 0;
+    std::vector<char> band_;
+
+    bool read_band(void);
+};
+
+#endif /* BMPREADER_HPP_ */
@@ -0,0 +1,280 @@
+#include "checkpoint.hpp"
+#include <fstream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Construct a new Checkpointer::Checkpointer object and starts the writer thread
+ *
+ * @param[in] path checkpoint file
+ * @param[in] every_epochs checkpoint every n epochs, 0 to disable
+ * @param[in] every_seconds checkpoint when this much time has passed, 0 to disable
+ */
+Checkpointer::Checkpointer(const char *path,
+                           const std::size_t every_epochs,
+                           const double every_seconds)
+    : path_(path),
+      every_epochs_(every_epochs),
+      every_ns_(every_seconds > 0.0 ? (uint64_t)(every_seconds * 1e9) : 0),
+      last_checkpoint_ns_(Profiler::now_ns())
+{
+    auto write = [this]()
+    { this->write_loop(); };
+    this->writer_ = std::thread(write);
+}
+
+/**
+ * @brief Destructor writes the last pending snapshot and stops the writer thread
+ *
+ */
+Checkpointer::~Checkpointer()
+{
+    this->wait();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->running_ = false;
+    }
+    this->pending_cv_.notify_one();
+    this->writer_.join();
+}
+
+/**
+ * @brief checkpoints if the epoch or time interval has been reached
+ *
+ * @param[in] network network to snapshot
+ * @param[in] epoch number of completed epochs
+ * @return true if a snapshot was taken
+ */
+bool Checkpointer::maybe_checkpoint(const NeuralNetwork &network, const std::size_t epoch)
+{
+    const bool epoch_due = this->every_epochs_ > 0 && epoch % this->every_epochs_ == 0;
+    const bool time_due = this->every_ns_ > 0 && Profiler::now_ns() - this->last_checkpoint_ns_ >= this->every_ns_;
+    if (!epoch_due && !time_due)
+    {
+        return false;
+    }
+    this->checkpoint(network, epoch);
+    return true;
+}
+
+/**
+ * @brief copies the network into a free buffer and hands it to the writer thread.
+ * @details never waits for the disk, the only cost on the calling thread is
+ *          one copy of the weights (no allocation after the first call).
+ *
+ * @param[in] network network to snapshot
+ * @param[in] epoch number of completed epochs
+ */
+void Checkpointer::checkpoint(const NeuralNetwork &network, const std::size_t epoch)
+{
+    Buffer *buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        for (auto &candidate : this->buffers_)
+        {
+            if (candidate.state == buffer_state::FREE)
+            {
+                buffer = &candidate;
+                break;
+            }
+        }
+        if (buffer == nullptr)
+        {
+            for (auto &candidate : this->buffers_)
+            {
+                if (candidate.state == buffer_state::PENDING &&
+                    (buffer == nullptr || candidate.epoch < buffer->epoch))
+                {
+                    buffer = &candidate;
+                }
+            }
+            this->num_skipped_++;
+        }
+        if (buffer == nullptr)
+        {
+            return;
+        }
+        buffer->state = buffer_state::FILLING;
+    }
+
+    {
+        PROFILE_SCOPE("checkpoint_copy", -1, 0, network.snapshot_size());
+        buffer->data.resize(network.snapshot_size());
+        network.save_snapshot(buffer->data.data(), epoch);
+        buffer->epoch = epoch;
+    }
+    this->last_checkpoint_ns_ = Profiler::now_ns();
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        buffer->state = buffer_state::PENDING;
+    }
+    this->pending_cv_.notify_one();
+}
+
+/**
+ * @brief blocks until every snapshot taken so far is on disk
+ *
+ */
+void Checkpointer::wait(void)
+{
+    auto all_free = [this]()
+    {
+        for (const auto &buffer : this->buffers_)
+        {
+            if (buffer.state != buffer_state::FREE)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->done_cv_.wait(lock, all_free);
+}
+
+/**
+ * @brief returns the number of checkpoint files written
+ *
+ * @return std::size_t
+ */
+std::size_t Checkpointer::num_written(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->num_written_;
+}
+
+/**
+ * @brief returns the number of snapshots replaced by a newer one before they were written
+ *
+ * @return std::size_t
+ */
+std::size_t Checkpointer::num_skipped(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->num_skipped_;
+}
+
+/**
+ * @brief returns the result of the last write
+ *
+ * @return int 0 if no errors, 1 if the file can't be opened, 2 if the write failed,
+ *         3 if the file can't be renamed
+ */
+int Checkpointer::last_error(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->last_error_;
+}
+
+/**
+ * @brief reads a checkpoint file into memory
+ *
+ * @param[in] path checkpoint file
+ * @param[out] buffer file content
+ * @return int 0 if no errors, 1 if the file can't be read
+ */
+int Checkpointer::read(const char *path, std::vector<char> &buffer)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return 1;
+    }
+    const std::streamsize size = file.tellg();
+    if (size < 0)
+    {
+        return 1;
+    }
+    buffer.resize(size);
+    file.seekg(0);
+    if (!file.read(buffer.data(), size))
+    {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief writer thread, writes pending snapshots (oldest epoch first) until stopped
+ *
+ */
+void Checkpointer::write_loop(void)
+{
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    while (true)
+    {
+        Buffer *buffer = nullptr;
+        for (auto &candidate : this->buffers_)
+        {
+            if (candidate.state == buffer_state::PENDING &&
+                (buffer == nullptr || candidate.epoch < buffer->epoch))
+            {
+                buffer = &candidate;
+            }
+        }
+        if (buffer == nullptr)
+        {
+            if (!this->running_)
+            {
+                return;
+            }
+            this->pending_cv_.wait(lock);
+            continue;
+        }
+
+        buffer->state = buffer_state::WRITING;
+        lock.unlock();
+        const int ret = this->write_file(*buffer);
+        lock.lock();
+        buffer->state = buffer_state::FREE;
+        this->last_error_ = ret;
+        if (ret == 0)
+        {
+            this->num_written_++;
+        }
+        this->done_cv_.notify_all();
+    }
+}
+
+/**
+ * @brief writes a snapshot to "<path>.tmp", flushes it to disk and renames it to path
+ *
+ * @param[in] buffer snapshot to write
+ * @return int 0 if no errors, 1 if the file can't be opened, 2 if the write failed,
+ *         3 if the file can't be renamed
+ */
+int Checkpointer::write_file(const Buffer &buffer)
+{
+    const std::string tmp_path = this->path_ + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    const char *data = buffer.data.data();
+    std::size_t remaining = buffer.data.size();
+    while (remaining > 0)
+    {
+        const ssize_t n = ::write(fd, data, remaining);
+        if (n <= 0)
+        {
+            ::close(fd);
+            return 2;
+        }
+        data += n;
+        remaining -= n;
+    }
+    if (fsync(fd) != 0)
+    {
+        ::close(fd);
+        return 2;
+    }
+    ::close(fd);
+    if (std::rename(tmp_path.c_str(), this->path_.c_str()) != 0)
+    {
+        return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "neuralnetwork.hpp"
+
+/**
+ * @brief Class for writing training checkpoints without stalling training.
+ * @details the training thread only copies the network into one of two
+ *          preallocated buffers (NeuralNetwork::save_snapshot), a background
+ *          thread writes it to "<path>.tmp", calls fsync and renames it to
+ *          path. A crash in the middle of a write therefore always leaves the
+ *          previous checkpoint intact.
+ *
+ *          If a snapshot is still waiting while the writer is busy, the new
+ *          one replaces it (the old one is counted as skipped), so training
+ *          never waits for the disk.
+ *
+ * @param[in] path checkpoint file
+ * @param[in] every_epochs checkpoint every n epochs, 0 to disable
+ * @param[in] every_seconds checkpoint when this much time has passed, 0 to disable
+ */
+class Checkpointer
+{
+public:
+    Checkpointer(const char *path,
+                 const std::size_t every_epochs = 1,
+                 const double every_seconds = 0.0);
+    ~Checkpointer();
+    Checkpointer(const Checkpointer &) = delete;
+    Checkpointer &operator=(const Checkpointer &) = delete;
+    bool maybe_checkpoint(const NeuralNetwork &network, const std::size_t epoch);
+    void checkpoint(const NeuralNetwork &network, const std::size_t epoch);
+    void wait(void);
+    std::size_t num_written(void);
+    std::size_t num_skipped(void);
+    int last_error(void);
+    static int read(const char *path, std::vector<char> &buffer);
+
+private:
+    enum class buffer_state
+    {
+        FREE,
+        FILLING,
+        PENDING,
+        WRITING
+    };
+
+    struct Buffer
+    {
+        std::vector<char> data;
+        std::size_t epoch = 0;
+        buffer_state state = buffer_state::FREE;
+    };
+
+    std::string path_;
+    std::size_t every_epochs_;
+    uint64_t every_ns_;
+    uint64_t last_checkpoint_ns_;
+    std::array<Buffer, 2> buffers_;
+    std::size_t num_written_ = 0;
+    std::size_t num_skipped_ = 0;
+    int last_error_ = 0;
+    bool running_ = true;
+    std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::condition_variable done_cv_;
+    std::thread writer_;
+
+    void write_loop(void);
+    int write_file(const Buffer &buffer);
+};
+
+#endif /* CHECKPOINT_HPP_ */
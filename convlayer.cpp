@@ -1,4 +1,17 @@
 #include "convlayer.hpp"
+#include "convtuner.hpp"
+#include "bmpreader.hpp"
+#include "kernels.hpp"
+#include <thread>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ * @brief fewest output rows a TILED_PARALLEL thread gets, smaller images are
+ *        convoluted by the calling thread alone since starting a thread costs
+ *        more than convoluting a few rows
+ */
+static const std::size_t TILE_MIN_ROWS = 16;
 
 /**
  * @brief 
@@ -8,24 +21,133 @@
  */
 int ConvLayer::import_image_from_bmp(const char *filename)
 {
+    PROFILE_SCOPE("import_image_from_bmp", -1, 0, 0);
+    std::string content;
+    int ret = read_file(filename, content);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    return import_image_from_memory(content);
+}
 
+/**
+ * @brief 
+ * reads a whole file into a string.
+ * @param[in] filename path and file name
+ * @param[out] content the bytes of the file
+ * @return int 0 if no errors, 1 if the file is missing or smaller than a bitmap header
+ */
+int ConvLayer::read_file(const char *filename, std::string &content)
+{
     std::ifstream file(filename, std::ios::binary);
     std::ifstream::pos_type filesize;
-    std::string content;
-    if (file.is_open())
+    if (!file.is_open())
+    {
+        return 1;
+    }
+    file.seekg(0, std::ios::end);
+    filesize = file.tellg();
+    if (filesize < SIZE_OF_HEADER)
+    {
+        return 1;
+    }
+    content.resize(filesize);
+    file.seekg(0, std::ios::beg);
+    file.read(&content[0], filesize);
+    file.close();
+    return 0;
+}
+
+/**
+ * @brief 
+ * imports a 24-bit bitmap that is already loaded into memory.
+ * @param[in] content the bytes of a bitmap file
+ * @return int 0 if no errors
+ */
+int ConvLayer::import_image_from_memory(const std::string &content)
+{
+    uint32_t x_width = 0;
+    uint32_t y_height = 0;
+    std::size_t row_bytes = 0;
+    int ret = check_bmp_header(content.data(), content.size(), x_width, y_height, row_bytes);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    // resize image vector
+    m_image.resize(y_height, std::vector<double>(x_width, 0.0));
+
+    // fill the container with "rgb-flatten" pixeldata
+    // pixeldata begins at index 54
+    // each pixel have 3 entries.
+    // each row is padded with zeros to a multiple of 4 bytes
+    // invert the row order
+    std::size_t i = SIZE_OF_HEADER;
+    for (int32_t row = m_image.size() - 1; row >= 0; row--)
     {
-        file.seekg(0, std::ios::end);
-        filesize = file.tellg();
-        if (filesize < SIZE_OF_HEADER)
+        for (std::size_t pixel = 0; pixel < m_image[row].size(); pixel++)
         {
-            return 1;
+            m_image[row][pixel] = (double)((uint8_t)content[i + 3 * pixel] + (uint8_t)content[i + 3 * pixel + 1] +
+                                           (uint8_t)content[i + 3 * pixel + 2]) / 3;
         }
-        content.resize(filesize);
-        file.seekg(0, std::ios::beg);
-        file.read(&content[0], filesize);
-        file.close();
+        i += row_bytes;
     }
-    
+    return 0;
+}
+
+/**
+ * @brief 
+ * imports a 24-bit bitmap into a compact image with one byte per pixel.
+ * The rgb average is rounded down, which is exact for grey scale bitmaps.
+ * @param[in] content the bytes of a bitmap file
+ * @param[out] image grey scale image
+ * @return int 0 if no errors, see import_image_from_memory
+ */
+int ConvLayer::import_image_from_memory(const std::string &content, FeatureMap<uint8_t> &image)
+{
+    PROFILE_SCOPE("import_image_compact", -1, 0, 0);
+    uint32_t x_width = 0;
+    uint32_t y_height = 0;
+    std::size_t row_bytes = 0;
+    int ret = check_bmp_header(content.data(), content.size(), x_width, y_height, row_bytes);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    image.resize(y_height, x_width);
+
+    // same layout as in import_image_from_memory, rows are stored bottom up
+    std::size_t i = SIZE_OF_HEADER;
+    for (std::size_t row = y_height; row-- > 0;)
+    {
+        grey_row(content.data() + i, x_width, image.row(row));
+        i += row_bytes;
+    }
+    return 0;
+}
+
+/**
+ * @brief 
+ * checks that the content is a 24-bit bitmap that is large enough for its size.
+ * Only the first SIZE_OF_HEADER bytes are read, so a streaming reader can pass
+ * the header alone together with the size of the file.
+ * @param[in] content the bytes of a bitmap file, at least the header
+ * @param[in] file_size size of the whole file
+ * @param[out] x_width width in pixels
+ * @param[out] y_height height in pixels
+ * @param[out] row_bytes bytes per row in the file, 3 per pixel padded to a multiple of 4
+ * @return int 0 if no errors, 1 if smaller than the header, 2 if not a bitmap,
+ *         3 if not 24-bit, 4 if the pixel data is cut short
+ */
+int ConvLayer::check_bmp_header(const char *content, const std::size_t file_size,
+                                uint32_t &x_width, uint32_t &y_height, std::size_t &row_bytes)
+{
+    if (file_size < SIZE_OF_HEADER)
+    {
+        return 1;
+    }
+
     //checks the image if its of type BNP
     if (((content[0]) != 0x42) || ((content[1]) != 0x4d))
     {
@@ -42,35 +164,33 @@ int ConvLayer::import_image_from_bmp(const char *filename)
     //      lsb      msb
     //  x = 18 19 20 21
     //  y = 22 23 24 25   
-    const uint32_t x_width = (content[18] | (content[19] << 8) | (content[20] << 16) | (content[21] << 24));
-    const uint32_t y_height = (content[22] | (content[23] << 8) | (content[24] << 16) | (content[25] << 24));
+    const uint8_t *header = (const uint8_t *)content;
+    x_width = (uint32_t)header[18] | ((uint32_t)header[19] << 8) | ((uint32_t)header[20] << 16) | ((uint32_t)header[21] << 24);
+    y_height = (uint32_t)header[22] | ((uint32_t)header[23] << 8) | ((uint32_t)header[24] << 16) | ((uint32_t)header[25] << 24);
 
-    auto sum = SIZE_OF_HEADER + (x_width + 1) * y_height * 3;
-    //std::cout << "sum: " << sum << std::endl;
-    //std::cout << content.size() << std::endl;
-    if  (sum > content.size())
+    row_bytes = ((std::size_t)x_width * 3 + 3) / 4 * 4;
+    if ((file_size - SIZE_OF_HEADER) / row_bytes < y_height)
     {
         return 4;
     }
-    // resize image vector
-    m_image.resize(y_height, std::vector<double>(x_width, 0.0));
+    return 0;
+}
 
-    // fill the container with "rgb-flatten" pixeldata
-    // pixeldata begins at index 54
-    // each pixel have 3 entries.
-    // each row ends with 00 00 00
-    // invert the row order
-    std::size_t i = SIZE_OF_HEADER;
-    for (int32_t row = m_image.size() - 1; row >= 0; row--)
+/**
+ * @brief 
+ * converts one row of bgr pixels to grey, the average is rounded down.
+ * @param[in] bgr 3 bytes per pixel
+ * @param[in] width number of pixels
+ * @param[out] grey one byte per pixel
+ */
+void ConvLayer::grey_row(const char *bgr, const std::size_t width, uint8_t *grey)
+{
+    const uint8_t *in = (const uint8_t *)bgr;
+    for (std::size_t pixel = 0; pixel < width; pixel++)
     {
-        for (std::size_t pixel = 0; pixel < m_image[row].size(); pixel++)
-        {
-            m_image[row][pixel] = (double)((uint8_t)content[i] + (uint8_t)content[i + 1] + (uint8_t)content[i + 2]) / 3;
-            i += 3;
-        }
-        i += 3;
+        grey[pixel] = (uint8_t)((in[0] + in[1] + in[2]) / 3);
+        in += 3;
     }
-    return 0;
 }
 
 /**
@@ -161,13 +281,16 @@ void ConvLayer::convolute(uint8_t stride)
     std::size_t output_size_height = ((m_image.size() - m_kernel.size()) / stride)+1;
     std::size_t output_size_width = ((m_image[0].size() - m_kernel.size()) / stride)+1;
 
+    MEMORY_SCOPE("convolute");
     m_output.resize(output_size_height, std::vector<double>(output_size_width, 0));
+    PROFILE_SCOPE("convolute", -1, 2 * output_size_height * output_size_width * m_kernel.size() * m_kernel.size(),
+                  sizeof(double) * output_size_height * output_size_width * (m_kernel.size() * m_kernel.size() + 1));
 
     for (std::size_t row = 0; row < m_output.size(); row++)
     {
         for (std::size_t pixel = 0; pixel < m_output[row].size(); pixel++)
         {
-            m_output[row][pixel] = conv_calc(row, pixel);
+            m_output[row][pixel] = conv_calc(row * stride, pixel * stride);
         }
     }
 }
@@ -175,21 +298,19 @@ void ConvLayer::convolute(uint8_t stride)
 /**
  * @brief 
  * the detail extraction methood used in convolute for every pixel in the output container
- * @param[in] y_height output container y coordinates
- * @param[in] x_width output container x coordinates
+ * @param[in] y_height image row under the top of the kernel (output row * stride)
+ * @param[in] x_width image pixel under the left of the kernel (output pixel * stride)
  * @return double 
  */
 uint8_t ConvLayer::conv_calc(size_t y_height, size_t x_width)
 {
+    const Kernels &kernels = Kernels::instance();
     double sum = 0;
-    int i = 0;
+    std::size_t i = 0;
     for (std::size_t y = 0; y < m_kernel.size(); y++)
     {
-        for (std::size_t x = 0; x < m_kernel[y].size(); x++)
-        {
-            sum += m_image[y_height + y][x_width + x] * m_kernel[y][x];
-            i++;
-        }
+        sum = kernels.dot(&m_image[y_height + y][x_width], m_kernel[y].data(), m_kernel[y].size(), sum);
+        i += m_kernel[y].size();
     }
 
     sum = i > 0 ? sum / i : 0;
@@ -217,6 +338,8 @@ void ConvLayer::pooling(PoolingOption pooling_option, size_t pooling_size)
 {
     init_kernel(pooling_size);
     m_output.resize(m_image.size() / pooling_size, std::vector<double>(m_image[0].size() / pooling_size, 0));
+    PROFILE_SCOPE("pooling", -1, m_output.size() * (m_image[0].size() / pooling_size) * pooling_size * pooling_size,
+                  sizeof(double) * m_output.size() * (m_image[0].size() / pooling_size) * (pooling_size * pooling_size + 1));
 
     for (std::size_t row = 0; row < m_output.size(); row++)
     {
@@ -238,31 +361,815 @@ void ConvLayer::pooling(PoolingOption pooling_option, size_t pooling_size)
  */
 uint8_t ConvLayer::pool(PoolingOption pooling_option, size_t pooling_size, size_t y_height, size_t x_width)
 {
+    const Kernels &kernels = Kernels::instance();
     double sum = 0;
-    int i = 0;
+    std::size_t i = 0;
     for (std::size_t y = 0; y < m_kernel.size(); y++)
     {
-        for (std::size_t x = 0; x < m_kernel[y].size(); x++)
+        const double *values = &m_image[y_height * pooling_size + y][x_width * pooling_size];
+        if (pooling_option == PoolingOption::MAX)
         {
-            double val = m_image[y_height * pooling_size + y][x_width * pooling_size + x];
-            if (pooling_option == PoolingOption::MAX)
+            sum = kernels.max(values, m_kernel[y].size(), sum);
+        }
+        else if (pooling_option == PoolingOption::AVERAGE)
+        {
+            sum = kernels.sum(values, m_kernel[y].size(), sum);
+        }
+        i += m_kernel[y].size();
+    }
+
+    if (pooling_option == PoolingOption::AVERAGE)
+    {
+        sum = i > 0 ? (sum / i) : 0;
+    }
+
+    return uint8_t(sum);
+}
+
+/**
+ * @brief 
+ * convolute for compact images, gives the same result as zero_padding + convolute.
+ * The padding is not stored, pixels outside the image are read as 0. Every pixel
+ * is widened to double when it is multiplied with the kernel. All algorithms add
+ * the products in the same order, so they give exactly the same output.
+ * @param[in] image input image or feature map
+ * @param[in] kernel kernel weights from init_kernel
+ * @param[in] stride higher values skips pixels and reduces details and output size
+ * @param[in] zero_padding true to add a border of zeros around the image
+ * @param[out] output feature map, one byte per pixel
+ * @param[in] algorithm implementation to use, AUTO asks ConvTuner
+ */
+template <typename T>
+void ConvLayer::convolute(const FeatureMap<T> &image, const std::vector<std::vector<double>> &kernel,
+                          uint8_t stride, const bool zero_padding, FeatureMap<uint8_t> &output,
+                          ConvAlgorithm algorithm)
+{
+    convolute(image.data().data(), image.height(), image.width(), kernel, stride, zero_padding, output, algorithm);
+}
+
+/**
+ * @brief 
+ * convolute for one compact image plane stored row by row, e.g. one image of
+ * a Tensor, see convolute(const FeatureMap<T> &image, ...).
+ * @param[in] image height * width pixels
+ * @param[in] image_height number of rows
+ * @param[in] image_width number of pixels per row
+ * @param[in] kernel kernel weights from init_kernel
+ * @param[in] stride higher values skips pixels and reduces details and output size
+ * @param[in] zero_padding true to add a border of zeros around the image
+ * @param[out] output feature map, one byte per pixel
+ * @param[in] algorithm implementation to use, AUTO asks ConvTuner
+ */
+template <typename T>
+void ConvLayer::convolute(const T *image, const std::size_t image_height, const std::size_t image_width,
+                          const std::vector<std::vector<double>> &kernel, uint8_t stride, const bool zero_padding,
+                          FeatureMap<uint8_t> &output, ConvAlgorithm algorithm)
+{
+    stride = stride + 1;
+    const std::size_t pad = zero_padding ? 1 : 0;
+    const std::size_t height = image_height + 2 * pad;
+    const std::size_t width = image_width + 2 * pad;
+    const std::size_t size = kernel.size();
+    if (size == 0 || height < size || width < size)
+    {
+        output.resize(0, 0);
+        return;
+    }
+    if (algorithm == ConvAlgorithm::AUTO)
+    {
+        if constexpr (std::is_same<T, uint8_t>::value)
+        {
+            algorithm = ConvTuner::instance().select(image, image_height, image_width, kernel, stride - 1, zero_padding);
+        }
+        else
+        {
+            algorithm = ConvAlgorithm::DIRECT;
+        }
+    }
+    MEMORY_SCOPE("convolute_compact");
+    output.resize(((height - size) / stride) + 1, ((width - size) / stride) + 1);
+    PROFILE_SCOPE("convolute_compact", -1, 2 * output.size() * size * size,
+                  sizeof(T) * output.size() * size * size + output.bytes());
+
+    if (algorithm == ConvAlgorithm::IM2COL)
+    {
+        convolute_im2col(image, image_height, image_width, kernel, stride, pad, output);
+    }
+    else if (algorithm == ConvAlgorithm::TILED_PARALLEL)
+    {
+        static const std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        const std::size_t num_tiles = std::max<std::size_t>(1, std::min(num_threads, output.height() / TILE_MIN_ROWS));
+        std::vector<std::thread> threads;
+        for (std::size_t t = 1; t < num_tiles; t++)
+        {
+            threads.emplace_back(convolute_rows<T>, image, image_height, image_width, std::cref(kernel), stride, pad,
+                                 std::ref(output), output.height() * t / num_tiles, output.height() * (t + 1) / num_tiles);
+        }
+        convolute_rows(image, image_height, image_width, kernel, stride, pad, output, 0, output.height() / num_tiles);
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+    else
+    {
+        convolute_rows(image, image_height, image_width, kernel, stride, pad, output, 0, output.height());
+    }
+}
+
+/**
+ * @brief 
+ * the direct convolution of the output rows [first_row, last_row), used by
+ * DIRECT for all rows and by TILED_PARALLEL for one tile per thread.
+ * @param[in] image height * width pixels
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] kernel kernel weights
+ * @param[in] stride distance between two kernel windows (1 for every pixel)
+ * @param[in] pad 1 if the image is zero padded, otherwise 0
+ * @param[out] output feature map, already resized
+ * @param[in] first_row first output row
+ * @param[in] last_row one past the last output row
+ */
+template <typename T>
+void ConvLayer::convolute_rows(const T *image, const std::size_t height, const std::size_t width,
+                               const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                               const std::size_t pad, FeatureMap<uint8_t> &output, const std::size_t first_row,
+                               const std::size_t last_row)
+{
+    const std::size_t size = kernel.size();
+    std::vector<const T *> rows(size);
+    for (std::size_t row = first_row; row < last_row; row++)
+    {
+        for (std::size_t y = 0; y < size; y++)
+        {
+            const std::size_t image_y = row * stride + y - pad;
+            rows[y] = row * stride + y < pad || image_y >= height ? nullptr : image + image_y * width;
+        }
+        convolute_row(rows.data(), width, kernel, stride, pad, output.row(row), output.width());
+    }
+}
+
+/**
+ * @brief 
+ * calculates one output row of the direct convolution from the image rows
+ * under the kernel, so the rows don't have to be stored next to each other.
+ * @param[in] rows one pointer per kernel row, nullptr for rows in the zero padding
+ * @param[in] width number of pixels per image row
+ * @param[in] kernel kernel weights
+ * @param[in] stride distance between two kernel windows (1 for every pixel)
+ * @param[in] pad 1 if the image is zero padded, otherwise 0
+ * @param[out] output output row
+ * @param[in] output_width number of pixels in the output row
+ */
+template <typename T>
+void ConvLayer::convolute_row(const T *const *rows, const std::size_t width,
+                              const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                              const std::size_t pad, uint8_t *output, const std::size_t output_width)
+{
+    const std::size_t size = kernel.size();
+    for (std::size_t pixel = 0; pixel < output_width; pixel++)
+    {
+        double sum = 0;
+        for (std::size_t y = 0; y < size; y++)
+        {
+            const T *in = rows[y];
+            if (in == nullptr)
             {
-                sum = sum < val ? val : sum;
+                continue;
             }
-            else if (pooling_option == PoolingOption::AVERAGE)
+            for (std::size_t x = 0; x < size; x++)
             {
-                sum += val;
+                const std::size_t image_x = pixel * stride + x - pad;
+                if (pixel * stride + x >= pad && image_x < width)
+                {
+                    sum += (double)in[image_x] * kernel[y][x];
+                }
             }
-            i++;
         }
+        output[pixel] = uint8_t(sum / (double)(size * size));
     }
+}
 
-    if (pooling_option == PoolingOption::AVERAGE)
+/**
+ * @brief 
+ * convolution as a matrix-vector product: the kernel window of every output
+ * pixel is copied into one row of a column matrix (im2col), which is then
+ * multiplied with the flattened kernel in one tight loop.
+ * @param[in] image height * width pixels
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] kernel kernel weights
+ * @param[in] stride distance between two kernel windows (1 for every pixel)
+ * @param[in] pad 1 if the image is zero padded, otherwise 0
+ * @param[out] output feature map, already resized
+ */
+template <typename T>
+void ConvLayer::convolute_im2col(const T *image, const std::size_t height, const std::size_t width,
+                                 const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                                 const std::size_t pad, FeatureMap<uint8_t> &output)
+{
+    const std::size_t size = kernel.size();
+    const std::size_t window = size * size;
+    std::vector<double> flat_kernel(window);
+    for (std::size_t y = 0; y < size; y++)
     {
-        sum = i > 0 ? (sum / i) : 0;
+        std::copy(kernel[y].begin(), kernel[y].begin() + size, flat_kernel.begin() + y * size);
     }
 
-    return uint8_t(sum);
+    std::vector<double> columns(output.width() * window);
+    for (std::size_t row = 0; row < output.height(); row++)
+    {
+        double *column = columns.data();
+        for (std::size_t pixel = 0; pixel < output.width(); pixel++)
+        {
+            for (std::size_t y = 0; y < size; y++)
+            {
+                const std::size_t image_y = row * stride + y - pad;
+                const bool inside = row * stride + y >= pad && image_y < height;
+                for (std::size_t x = 0; x < size; x++)
+                {
+                    const std::size_t image_x = pixel * stride + x - pad;
+                    *column++ = inside && pixel * stride + x >= pad && image_x < width ? image[image_y * width + image_x] : 0.0;
+                }
+            }
+        }
+
+        uint8_t *out = output.row(row);
+        for (std::size_t pixel = 0; pixel < output.width(); pixel++)
+        {
+            const double *values = &columns[pixel * window];
+            double sum = 0;
+            for (std::size_t k = 0; k < window; k++)
+            {
+                sum += values[k] * flat_kernel[k];
+            }
+            out[pixel] = uint8_t(sum / (double)window);
+        }
+    }
+}
+
+/**
+ * @brief 
+ * pooling for compact feature maps, gives the same result as pooling.
+ * The pixels are summed or compared as integers.
+ * @param[in] image input feature map
+ * @param[in] pooling_option method for the calculation MAX/AVERAGE
+ * @param[in] pooling_size the size of the pooling
+ * @param[out] output feature map, one byte per pixel
+ */
+template <typename T>
+void ConvLayer::pooling(const FeatureMap<T> &image, PoolingOption pooling_option, size_t pooling_size,
+                        FeatureMap<uint8_t> &output)
+{
+    pooling(image.data().data(), image.height(), image.width(), pooling_option, pooling_size, output);
+}
+
+/**
+ * @brief 
+ * pooling for one compact feature map stored row by row.
+ * @param[in] image height * width pixels
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] pooling_option method for the calculation MAX/AVERAGE
+ * @param[in] pooling_size the size of the pooling
+ * @param[out] output feature map, one byte per pixel
+ */
+template <typename T>
+void ConvLayer::pooling(const T *image, const std::size_t height, const std::size_t width,
+                        PoolingOption pooling_option, size_t pooling_size, FeatureMap<uint8_t> &output)
+{
+    if (pooling_size == 0)
+    {
+        output.resize(0, 0);
+        return;
+    }
+    output.resize(height / pooling_size, width / pooling_size);
+    PROFILE_SCOPE("pooling_compact", -1, output.size() * pooling_size * pooling_size,
+                  sizeof(T) * output.size() * pooling_size * pooling_size + output.bytes());
+
+    for (std::size_t row = 0; row < output.height(); row++)
+    {
+        uint8_t *out = output.row(row);
+        for (std::size_t pixel = 0; pixel < output.width(); pixel++)
+        {
+            uint32_t value = 0;
+            for (std::size_t y = 0; y < pooling_size; y++)
+            {
+                const T *in = image + (row * pooling_size + y) * width + pixel * pooling_size;
+                for (std::size_t x = 0; x < pooling_size; x++)
+                {
+                    if (pooling_option == PoolingOption::MAX)
+                    {
+                        value = value < in[x] ? in[x] : value;
+                    }
+                    else if (pooling_option == PoolingOption::AVERAGE)
+                    {
+                        value += in[x];
+                    }
+                }
+            }
+            if (pooling_option == PoolingOption::AVERAGE)
+            {
+                out[pixel] = uint8_t(value / (double)(pooling_size * pooling_size));
+            }
+            else
+            {
+                out[pixel] = uint8_t(value);
+            }
+        }
+    }
+}
+
+template void ConvLayer::convolute<uint8_t>(const FeatureMap<uint8_t> &, const std::vector<std::vector<double>> &,
+                                            uint8_t, const bool, FeatureMap<uint8_t> &, ConvAlgorithm);
+template void ConvLayer::convolute<uint16_t>(const FeatureMap<uint16_t> &, const std::vector<std::vector<double>> &,
+                                             uint8_t, const bool, FeatureMap<uint8_t> &, ConvAlgorithm);
+template void ConvLayer::convolute<uint8_t>(const uint8_t *, const std::size_t, const std::size_t,
+                                            const std::vector<std::vector<double>> &, uint8_t, const bool,
+                                            FeatureMap<uint8_t> &, ConvAlgorithm);
+template void ConvLayer::convolute<uint16_t>(const uint16_t *, const std::size_t, const std::size_t,
+                                             const std::vector<std::vector<double>> &, uint8_t, const bool,
+                                             FeatureMap<uint8_t> &, ConvAlgorithm);
+template void ConvLayer::pooling<uint8_t>(const FeatureMap<uint8_t> &, PoolingOption, size_t, FeatureMap<uint8_t> &);
+template void ConvLayer::pooling<uint16_t>(const FeatureMap<uint16_t> &, PoolingOption, size_t, FeatureMap<uint8_t> &);
+template void ConvLayer::pooling<uint8_t>(const uint8_t *, const std::size_t, const std::size_t,
+                                          PoolingOption, size_t, FeatureMap<uint8_t> &);
+template void ConvLayer::pooling<uint16_t>(const uint16_t *, const std::size_t, const std::size_t,
+                                           PoolingOption, size_t, FeatureMap<uint8_t> &);
+
+/**
+ * @brief 
+ * trainable convolute -> pooling of an image with the kernel of this layer.
+ * Unlike the static pipeline the values are not truncated to 8 bits, so the
+ * features are differentiable in the kernel weights. The kernel windows are
+ * stored as an im2col matrix with one row per kernel weight, the conv output
+ * is then a sum of kernel weight * row, and backpropagate uses the same rows
+ * for the kernel gradient. Max pooling records the conv pixel it picked, so
+ * the backward pass scatters the error instead of searching the windows again.
+ * The kernel is created with init_kernel(config.kernel_size) if it has another size.
+ * @param[in] image grey scale image
+ * @param[in] config pipeline settings, conv_algorithm and compact_storage are ignored
+ * @param[out] features flattened output of the pooling
+ */
+void ConvLayer::feedforward(const FeatureMap<double> &image, const PipelineConfig &config,
+                            std::vector<double> &features)
+{
+    MEMORY_SCOPE("conv_feedforward");
+    m_config = config;
+    if (m_kernel.size() != config.kernel_size)
+    {
+        init_kernel(config.kernel_size);
+    }
+    const std::size_t size = config.kernel_size;
+    const std::size_t window = size * size;
+    const std::size_t pad = config.zero_padding ? 1 : 0;
+    const std::size_t stride = config.stride + 1;
+    const std::size_t height = image.height() + 2 * pad;
+    const std::size_t width = image.width() + 2 * pad;
+    const std::size_t pooling_size = config.pooling_size;
+    features.clear();
+    m_argmax.clear();
+    if (size == 0 || height < size || width < size || pooling_size == 0)
+    {
+        m_conv.resize(0, 0);
+        m_columns.resize(0, 0);
+        return;
+    }
+    m_conv.resize((height - size) / stride + 1, (width - size) / stride + 1);
+    m_columns.resize(window, m_conv.size());
+    PROFILE_SCOPE("conv_feedforward", -1, 2 * m_conv.size() * window,
+                  sizeof(double) * m_conv.size() * (window + 1));
+
+    for (std::size_t y = 0; y < size; y++)
+    {
+        for (std::size_t x = 0; x < size; x++)
+        {
+            double *column = m_columns.row(y * size + x);
+            for (std::size_t row = 0; row < m_conv.height(); row++)
+            {
+                const std::size_t image_y = row * stride + y - pad;
+                const bool inside = row * stride + y >= pad && image_y < image.height();
+                for (std::size_t pixel = 0; pixel < m_conv.width(); pixel++)
+                {
+                    const std::size_t image_x = pixel * stride + x - pad;
+                    *column++ = inside && pixel * stride + x >= pad && image_x < image.width() ? image(image_y, image_x)
+                                                                                               : 0.0;
+                }
+            }
+        }
+    }
+
+    // conv = sum of kernel weight k * row k, every pixel adds its products in the row-major
+    // kernel order of convolute_row, so the conv equals its output before the uint8 truncation
+    const Kernels &kernels = Kernels::instance();
+    double *conv = m_conv.row(0);
+    for (std::size_t k = 0; k < window; k++)
+    {
+        kernels.axpy(conv, m_kernel[k / size][k % size], m_columns.row(k), m_conv.size());
+    }
+    for (std::size_t p = 0; p < m_conv.size(); p++)
+    {
+        conv[p] /= (double)window;
+    }
+
+    const std::size_t pool_height = m_conv.height() / pooling_size;
+    const std::size_t pool_width = m_conv.width() / pooling_size;
+    features.resize(pool_height * pool_width);
+    if (config.pooling_option == PoolingOption::MAX)
+    {
+        m_argmax.resize(features.size());
+    }
+    for (std::size_t row = 0; row < pool_height; row++)
+    {
+        for (std::size_t pixel = 0; pixel < pool_width; pixel++)
+        {
+            std::size_t best = row * pooling_size * m_conv.width() + pixel * pooling_size;
+            double sum = 0.0;
+            for (std::size_t y = 0; y < pooling_size; y++)
+            {
+                const std::size_t first = (row * pooling_size + y) * m_conv.width() + pixel * pooling_size;
+                for (std::size_t x = 0; x < pooling_size; x++)
+                {
+                    best = conv[first + x] > conv[best] ? first + x : best;
+                    sum += conv[first + x];
+                }
+            }
+            if (config.pooling_option == PoolingOption::MAX)
+            {
+                m_argmax[row * pool_width + pixel] = best;
+                features[row * pool_width + pixel] = conv[best];
+            }
+            else
+            {
+                features[row * pool_width + pixel] = sum / (double)(pooling_size * pooling_size);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 
+ * calculates the kernel gradient of the last feedforward from the error of
+ * every feature, e.g. NeuralNetwork::train_step. The error has the sign used by
+ * DenseLayer (reference - output), optimize adds it to the kernel.
+ * @param[in] feature_error one value per feature of the last feedforward
+ */
+void ConvLayer::backpropagate(const double *feature_error)
+{
+    const std::size_t size = m_kernel.size();
+    const std::size_t window = size * size;
+    const std::size_t pooling_size = m_config.pooling_size;
+    m_kernel_gradient.assign(window, 0.0);
+    m_conv_error.assign(m_conv.size(), 0.0);
+    if (m_conv.size() == 0)
+    {
+        return;
+    }
+    PROFILE_SCOPE("conv_backpropagate", -1, 2 * m_conv.size() * window,
+                  sizeof(double) * m_conv.size() * (window + 1));
+
+    if (m_config.pooling_option == PoolingOption::MAX)
+    {
+        for (std::size_t i = 0; i < m_argmax.size(); i++)
+        {
+            m_conv_error[m_argmax[i]] += feature_error[i];
+        }
+    }
+    else
+    {
+        const std::size_t pool_width = m_conv.width() / pooling_size;
+        const std::size_t num_features = (m_conv.height() / pooling_size) * pool_width;
+        for (std::size_t i = 0; i < num_features; i++)
+        {
+            const double share = feature_error[i] / (double)(pooling_size * pooling_size);
+            for (std::size_t y = 0; y < pooling_size; y++)
+            {
+                double *error = &m_conv_error[((i / pool_width) * pooling_size + y) * m_conv.width() +
+                                              (i % pool_width) * pooling_size];
+                for (std::size_t x = 0; x < pooling_size; x++)
+                {
+                    error[x] += share;
+                }
+            }
+        }
+    }
+
+    // gradient k = row k of the im2col matrix * conv error
+    const Kernels &kernels = Kernels::instance();
+    for (std::size_t k = 0; k < window; k++)
+    {
+        m_kernel_gradient[k] = kernels.dot(m_columns.row(k), m_conv_error.data(), m_conv.size(), 0.0) / (double)window;
+    }
+}
+
+/**
+ * @brief 
+ * adjusts the kernel with the gradient of the last backpropagate
+ * @param[in] learning_rate amount of error adjustment
+ */
+void ConvLayer::optimize(const double learning_rate)
+{
+    const std::size_t size = m_kernel.size();
+    if (m_kernel_gradient.size() != size * size)
+    {
+        return;
+    }
+    for (std::size_t k = 0; k < m_kernel_gradient.size(); k++)
+    {
+        m_kernel[k / size][k % size] += learning_rate * m_kernel_gradient[k];
+    }
+}
+
+/**
+ * @brief 
+ * returns the bytes allocated for the image, the kernel and the output
+ * @return MemoryTracker::Usage 
+ */
+MemoryTracker::Usage ConvLayer::memory_usage(void) const
+{
+    MemoryTracker::Usage usage;
+    usage.name = "conv layer";
+    usage.data = MemoryTracker::bytes(m_image);
+    usage.parameters = MemoryTracker::bytes(m_kernel) + MemoryTracker::bytes(m_kernel_gradient);
+    usage.activations = MemoryTracker::bytes(m_output) + m_columns.bytes() + m_conv.bytes() +
+                        MemoryTracker::bytes(m_argmax) + MemoryTracker::bytes(m_conv_error);
+    return usage;
+}
+
+/**
+ * @brief 
+ * estimates the memory extract_features needs for an image of the given size
+ * before anything is allocated, with one row per step of the pipeline.
+ * The conv output is moved into the pooling step so it is only counted once.
+ * @param[in] height image height in pixels
+ * @param[in] width image width in pixels
+ * @param[in] config pipeline settings
+ * @return std::vector<MemoryTracker::Usage> 
+ */
+std::vector<MemoryTracker::Usage> ConvLayer::estimate_memory(const std::size_t height, const std::size_t width,
+                                                             const PipelineConfig &config)
+{
+    const std::size_t pad = config.zero_padding ? 2 : 0;
+    const std::size_t stride = config.stride + 1;
+    const std::size_t size = config.kernel_size;
+    const std::size_t conv_height = height + pad >= size ? (height + pad - size) / stride + 1 : 0;
+    const std::size_t conv_width = width + pad >= size ? (width + pad - size) / stride + 1 : 0;
+    const std::size_t pool_height = config.pooling_size > 0 ? conv_height / config.pooling_size : 0;
+    const std::size_t pool_width = config.pooling_size > 0 ? conv_width / config.pooling_size : 0;
+
+    // bytes of a height * width image stored as rows of double or as one byte per pixel
+    auto image_bytes = [&config](const std::size_t rows, const std::size_t columns)
+    {
+        if (config.compact_storage)
+        {
+            return rows * columns * sizeof(uint8_t);
+        }
+        return rows * (sizeof(std::vector<double>) + columns * sizeof(double));
+    };
+    auto kernel_bytes = [](const std::size_t kernel_size)
+    {
+        return kernel_size * (sizeof(std::vector<double>) + kernel_size * sizeof(double));
+    };
+
+    std::vector<MemoryTracker::Usage> usage(4);
+    usage[0].name = "image";
+    usage[0].data = config.compact_storage ? image_bytes(height, width) : image_bytes(height + pad, width + pad);
+    usage[1].name = "convolute";
+    usage[1].parameters = kernel_bytes(size);
+    usage[1].activations = image_bytes(conv_height, conv_width);
+    usage[2].name = "pooling";
+    usage[2].parameters = config.compact_storage ? 0 : kernel_bytes(config.pooling_size);
+    usage[2].activations = image_bytes(pool_height, pool_width);
+    usage[3].name = "features";
+    usage[3].activations = pool_height * pool_width * sizeof(double);
+    return usage;
+}
+
+/**
+ * @brief 
+ * returns the kernel used by convolute
+ * @return const std::vector<std::vector<double>>& 
+ */
+const std::vector<std::vector<double>> &ConvLayer::get_kernel() const
+{
+    return m_kernel;
+}
+
+/**
+ * @brief 
+ * runs a bitmap through zero_padding -> convolute -> pooling and flattens the result,
+ * the same steps as used to create training data in main.
+ * @param[in] content the bytes of a bitmap file
+ * @param[in] config pipeline settings
+ * @param[out] features flattened output of the pooling
+ * @return int 0 if no errors, otherwise the error from import_image_from_memory
+ */
+int ConvLayer::extract_features(const std::string &content, const PipelineConfig &config,
+                                std::vector<double> &features)
+{
+    if (config.compact_storage)
+    {
+        FeatureMap<uint8_t> image;
+        int ret = import_image_from_memory(content, image);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        extract_features(image, config, features);
+        return 0;
+    }
+
+    ConvLayer conv;
+    int ret = conv.import_image_from_memory(content);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    conv.run_pipeline(config, features);
+    return 0;
+}
+
+/**
+ * @brief 
+ * runs an image through zero_padding -> convolute -> pooling and flattens the result.
+ * @param[in] image grey scale image, one value (0 - 255) per pixel
+ * @param[in] config pipeline settings
+ * @param[out] features flattened output of the pooling
+ */
+void ConvLayer::extract_features(const std::vector<std::vector<double>> &image, const PipelineConfig &config,
+                                 std::vector<double> &features)
+{
+    ConvLayer conv;
+    conv.m_image = image;
+    conv.run_pipeline(config, features);
+}
+
+/**
+ * @brief 
+ * runs a compact image through convolute -> pooling and flattens the result,
+ * the intermediate feature map is also stored with one byte per pixel.
+ * @param[in] image grey scale image
+ * @param[in] config pipeline settings
+ * @param[out] features flattened output of the pooling
+ */
+void ConvLayer::extract_features(const FeatureMap<uint8_t> &image, const PipelineConfig &config,
+                                 std::vector<double> &features)
+{
+    ConvLayer kernel;
+    kernel.init_kernel(config.kernel_size);
+    FeatureMap<uint8_t> conv_output;
+    FeatureMap<uint8_t> pool_output;
+    convolute(image, kernel.m_kernel, config.stride, config.zero_padding, conv_output, config.conv_algorithm);
+    pooling(conv_output, config.pooling_option, config.pooling_size, pool_output);
+    features.assign(pool_output.data().begin(), pool_output.data().end());
+}
+
+/**
+ * @brief 
+ * runs a batch of images through convolute -> pooling in one call. The kernel
+ * is created once, AUTO is resolved once for the shape shared by the batch and
+ * the conv/pool buffers are reused for every plane.
+ * @param[in] images N grey scale images with C channels each (NCHW)
+ * @param[in] config pipeline settings
+ * @param[out] features N rows, one per image, of C * pooled height * pooled width
+ *                      values, channel 0 first. Row n equals the features of
+ *                      extract_features for image n alone.
+ */
+void ConvLayer::extract_features(const Tensor<uint8_t> &images, const PipelineConfig &config,
+                                 FeatureMap<double> &features)
+{
+    MEMORY_SCOPE("extract_features_batch");
+    ConvLayer kernel;
+    kernel.init_kernel(config.kernel_size);
+    ConvAlgorithm algorithm = config.conv_algorithm;
+    if (algorithm == ConvAlgorithm::AUTO && images.size() > 0)
+    {
+        algorithm = ConvTuner::instance().select(images.plane(0, 0), images.height(), images.width(),
+                                                 kernel.m_kernel, config.stride, config.zero_padding);
+    }
+
+    FeatureMap<uint8_t> conv_output;
+    FeatureMap<uint8_t> pool_output;
+    for (std::size_t n = 0; n < images.batch(); n++)
+    {
+        for (std::size_t c = 0; c < images.channels(); c++)
+        {
+            convolute(images.plane(n, c), images.height(), images.width(), kernel.m_kernel, config.stride,
+                      config.zero_padding, conv_output, algorithm);
+            pooling(conv_output, config.pooling_option, config.pooling_size, pool_output);
+            if (n == 0 && c == 0)
+            {
+                features.resize(images.batch(), images.channels() * pool_output.size());
+            }
+            if (pool_output.size() > 0)
+            {
+                std::copy(pool_output.data().begin(), pool_output.data().end(),
+                          features.row(n) + c * pool_output.size());
+            }
+        }
+    }
+    if (images.size() == 0)
+    {
+        features.resize(images.batch(), 0);
+    }
+}
+
+/**
+ * @brief 
+ * runs a bitmap through convolute -> pooling while it is read, for images too
+ * large to load. Rows are read in bands by BmpReader into a ring buffer that
+ * holds the kernel_size rows under the kernel, every conv output row goes into
+ * a buffer of pooling_size rows that is pooled when it is full. Peak memory is
+ * O(width * (kernel_size + pooling_size + band_rows)) plus the features,
+ * whatever the height. The features equal extract_features with compact_storage.
+ * @param[in] filename path to a 24-bit bitmap
+ * @param[in] config pipeline settings, conv_algorithm is ignored (rows are direct)
+ * @param[out] features flattened output of the pooling
+ * @param[in] band_rows rows read from the file at a time, 0 for kernel_size
+ * @return int 0 if no errors, see check_bmp_header, 4 if the file can't be read
+ */
+int ConvLayer::stream_features(const char *filename, const PipelineConfig &config,
+                               std::vector<double> &features, const std::size_t band_rows)
+{
+    MEMORY_SCOPE("stream_features");
+    const std::size_t size = config.kernel_size;
+    BmpReader reader;
+    int ret = reader.open(filename, band_rows == 0 ? size : band_rows);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    features.clear();
+    const std::size_t pad = config.zero_padding ? 1 : 0;
+    const std::size_t stride = config.stride + 1;
+    const std::size_t height = reader.height() + 2 * pad;
+    const std::size_t width = reader.width() + 2 * pad;
+    const std::size_t pooling_size = config.pooling_size;
+    if (size == 0 || height < size || width < size || pooling_size == 0)
+    {
+        return 0;
+    }
+    const std::size_t conv_height = (height - size) / stride + 1;
+    const std::size_t conv_width = (width - size) / stride + 1;
+
+    ConvLayer kernel;
+    kernel.init_kernel(size);
+    FeatureMap<uint8_t> ring(size, reader.width());
+    FeatureMap<uint8_t> conv_rows(pooling_size, conv_width);
+    FeatureMap<uint8_t> pool_output;
+    std::vector<const uint8_t *> rows(size);
+    features.reserve((conv_height / pooling_size) * (conv_width / pooling_size));
+
+    // conv rows after the last full pooling window are never used
+    std::size_t num_loaded = 0;
+    for (std::size_t row = 0; row < conv_height / pooling_size * pooling_size; row++)
+    {
+        // output row `row` reads image rows row * stride - pad .. row * stride - pad + size - 1,
+        // the ring keeps the last size rows read, rows between two windows are read and dropped
+        const std::size_t end = std::min(row * stride + size - pad, reader.height());
+        for (; num_loaded < end; num_loaded++)
+        {
+            if (!reader.read_row(ring.row(num_loaded % size)))
+            {
+                return 4;
+            }
+        }
+        for (std::size_t y = 0; y < size; y++)
+        {
+            const std::size_t image_y = row * stride + y - pad;
+            rows[y] = row * stride + y < pad || image_y >= reader.height() ? nullptr : ring.row(image_y % size);
+        }
+        convolute_row(rows.data(), reader.width(), kernel.m_kernel, stride, pad, conv_rows.row(row % pooling_size),
+                      conv_width);
+        if (row % pooling_size == pooling_size - 1)
+        {
+            pooling(conv_rows, config.pooling_option, pooling_size, pool_output);
+            features.insert(features.end(), pool_output.data().begin(), pool_output.data().end());
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 
+ * the steps shared by both extract_features, runs on the imported image.
+ * @param[in] config pipeline settings
+ * @param[out] features flattened output of the pooling
+ */
+void ConvLayer::run_pipeline(const PipelineConfig &config, std::vector<double> &features)
+{
+    if (config.zero_padding)
+    {
+        zero_padding();
+    }
+    init_kernel(config.kernel_size);
+    convolute(config.stride);
+
+    ConvLayer pool;
+    pool.m_image = std::move(m_output);
+    pool.pooling(config.pooling_option, config.pooling_size);
+    features = pool.get_flatend_output();
 }
 
 /**
@@ -5,7 +5,11 @@
 #include <iomanip>
 #include <cstdlib>
 #include <fstream>
-#include <iomanip>
+#include <cstdint>
+#include "profiler.hpp"
+#include "featuremap.hpp"
+#include "tensor.hpp"
+#include "memorytracker.hpp"
 
 #define SIZE_OF_HEADER 54
 
@@ -31,9 +35,39 @@ public:
         MAX
     };
 
+    /**
+     * @brief implementations of the compact convolute, all give the same
+     *        output. AUTO lets ConvTuner pick the fastest for the shape.
+     *        TILED_PARALLEL runs DIRECT on the calling thread when the image
+     *        has too few rows to give every thread TILE_MIN_ROWS of them.
+     */
+    enum class ConvAlgorithm
+    {
+        AUTO,
+        DIRECT,
+        IM2COL,
+        TILED_PARALLEL
+    };
+
+    /**
+     * @brief settings for the conv -> pool -> flatten pipeline used to
+     *        turn a bitmap into training data.
+     */
+    struct PipelineConfig
+    {
+        bool zero_padding = true;
+        uint8_t kernel_size = 3;
+        uint8_t stride = 0;
+        PoolingOption pooling_option = PoolingOption::MAX;
+        std::size_t pooling_size = 2;
+        bool compact_storage = false;
+        ConvAlgorithm conv_algorithm = ConvAlgorithm::AUTO;
+    };
+
     ConvLayer(void) {}
     ~ConvLayer() {}
     int import_image_from_bmp(const char *filename);
+    int import_image_from_memory(const std::string &content);
     void import_image_from_vector(std::vector<std::vector<double>> image);
     void print(PrintOption print_option);
     void zero_padding();
@@ -42,11 +76,67 @@ public:
     std::vector<std::vector<double>> get_output();
     void pooling(PoolingOption pooling_option = PoolingOption::MAX, size_t pooling_size = 2);
     std::vector<double> get_flatend_output();
+    const std::vector<std::vector<double>> &get_kernel() const;
+    static int read_file(const char *filename, std::string &content);
+    static int check_bmp_header(const char *content, const std::size_t file_size,
+                                uint32_t &x_width, uint32_t &y_height, std::size_t &row_bytes);
+    static void grey_row(const char *bgr, const std::size_t width, uint8_t *grey);
+    static int extract_features(const std::string &content, const PipelineConfig &config,
+                                std::vector<double> &features);
+    static void extract_features(const std::vector<std::vector<double>> &image, const PipelineConfig &config,
+                                 std::vector<double> &features);
+    static int import_image_from_memory(const std::string &content, FeatureMap<uint8_t> &image);
+    template <typename T>
+    static void convolute(const FeatureMap<T> &image, const std::vector<std::vector<double>> &kernel,
+                          uint8_t stride, const bool zero_padding, FeatureMap<uint8_t> &output,
+                          ConvAlgorithm algorithm = ConvAlgorithm::DIRECT);
+    template <typename T>
+    static void convolute(const T *image, const std::size_t image_height, const std::size_t image_width,
+                          const std::vector<std::vector<double>> &kernel, uint8_t stride, const bool zero_padding,
+                          FeatureMap<uint8_t> &output, ConvAlgorithm algorithm = ConvAlgorithm::DIRECT);
+    template <typename T>
+    static void pooling(const FeatureMap<T> &image, PoolingOption pooling_option, size_t pooling_size,
+                        FeatureMap<uint8_t> &output);
+    template <typename T>
+    static void pooling(const T *image, const std::size_t height, const std::size_t width,
+                        PoolingOption pooling_option, size_t pooling_size, FeatureMap<uint8_t> &output);
+    static void extract_features(const FeatureMap<uint8_t> &image, const PipelineConfig &config,
+                                 std::vector<double> &features);
+    static void extract_features(const Tensor<uint8_t> &images, const PipelineConfig &config,
+                                 FeatureMap<double> &features);
+    static int stream_features(const char *filename, const PipelineConfig &config,
+                               std::vector<double> &features, const std::size_t band_rows = 0);
+    void feedforward(const FeatureMap<double> &image, const PipelineConfig &config, std::vector<double> &features);
+    void backpropagate(const double *feature_error);
+    void optimize(const double learning_rate);
+    MemoryTracker::Usage memory_usage(void) const;
+    static std::vector<MemoryTracker::Usage> estimate_memory(const std::size_t height, const std::size_t width,
+                                                             const PipelineConfig &config);
 
 private:
     std::vector<std::vector<double>> m_image;
     std::vector<std::vector<double>> m_kernel;
     std::vector<std::vector<double>> m_output;
+    PipelineConfig m_config;                // settings of the last feedforward
+    FeatureMap<double> m_columns;           // im2col, one row per kernel weight, one column per conv pixel
+    FeatureMap<double> m_conv;              // conv output of the last feedforward
+    std::vector<std::size_t> m_argmax;      // conv pixel chosen by every max pooled feature
+    std::vector<double> m_conv_error;
+    std::vector<double> m_kernel_gradient;
+    void run_pipeline(const PipelineConfig &config, std::vector<double> &features);
+    template <typename T>
+    static void convolute_rows(const T *image, const std::size_t height, const std::size_t width,
+                               const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                               const std::size_t pad, FeatureMap<uint8_t> &output, const std::size_t first_row,
+                               const std::size_t last_row);
+    template <typename T>
+    static void convolute_row(const T *const *rows, const std::size_t width,
+                              const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                              const std::size_t pad, uint8_t *output, const std::size_t output_width);
+    template <typename T>
+    static void convolute_im2col(const T *image, const std::size_t height, const std::size_t width,
+                                 const std::vector<std::vector<double>> &kernel, const std::size_t stride,
+                                 const std::size_t pad, FeatureMap<uint8_t> &output);
     uint8_t conv_calc(size_t y_height, size_t x_width);
     uint8_t pool(PoolingOption pooling_option, size_t pooling_size, size_t y_height, size_t x_width);
 };
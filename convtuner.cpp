@@ -0,0 +1,291 @@
+#include "convtuner.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+
+static const ConvLayer::ConvAlgorithm CONV_ALGORITHMS[] = {ConvLayer::ConvAlgorithm::DIRECT,
+                                                           ConvLayer::ConvAlgorithm::IM2COL,
+                                                           ConvLayer::ConvAlgorithm::TILED_PARALLEL};
+
+/**
+ * @brief returns the tuner shared by the whole program
+ *
+ * @return ConvTuner&
+ */
+ConvTuner &ConvTuner::instance(void)
+{
+    static ConvTuner tuner;
+    return tuner;
+}
+
+/**
+ * @brief loads the decisions of a cache file (created if missing), new
+ *        decisions are appended to it
+ *
+ * @param[in] filename path to the cache file
+ * @return int 0 if no errors, 1 if the file can't be created, 2 if it is not a tuning cache
+ */
+int ConvTuner::open(const char *filename)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::ofstream new_file(filename);
+        if (!new_file.is_open())
+        {
+            return 1;
+        }
+        new_file << CONV_TUNER_MAGIC << "\n";
+        this->filename_ = filename;
+        return 0;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != CONV_TUNER_MAGIC)
+    {
+        return 2;
+    }
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        std::string name;
+        if (!(fields >> key >> name))
+        {
+            continue;
+        }
+        for (const auto algorithm : CONV_ALGORITHMS)
+        {
+            if (name == algorithm_name(algorithm))
+            {
+                this->decisions_[key] = algorithm;
+            }
+        }
+    }
+    this->filename_ = filename;
+    return 0;
+}
+
+/**
+ * @brief returns the fastest algorithm for the shape of the image, tunes it
+ *        on the image the first time the shape is seen.
+ *
+ * @param[in] image height * width pixels
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] kernel kernel weights
+ * @param[in] stride stride as passed to convolute
+ * @param[in] zero_padding true if the image is zero padded
+ * @return ConvLayer::ConvAlgorithm never AUTO
+ */
+ConvLayer::ConvAlgorithm ConvTuner::select(const uint8_t *image, const std::size_t height, const std::size_t width,
+                                           const std::vector<std::vector<double>> &kernel,
+                                           const uint8_t stride, const bool zero_padding)
+{
+    const std::string key = make_key(height, width, kernel.size(), stride, zero_padding);
+    ConvLayer::ConvAlgorithm algorithm;
+    if (this->lookup(key, algorithm))
+    {
+        return algorithm;
+    }
+
+    algorithm = ConvLayer::ConvAlgorithm::DIRECT;
+    double best_us = -1.0;
+    for (const auto &timing : benchmark(image, height, width, kernel, stride, zero_padding))
+    {
+        if (timing.matches && (best_us < 0.0 || timing.us < best_us))
+        {
+            algorithm = timing.algorithm;
+            best_us = timing.us;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->decisions_[key] = algorithm;
+    this->num_tuned_++;
+    if (!this->filename_.empty())
+    {
+        std::ofstream file(this->filename_, std::ios::app);
+        file << key << " " << algorithm_name(algorithm) << "\n";
+    }
+    return algorithm;
+}
+
+/**
+ * @brief returns a decision made earlier in this run or loaded from the cache file
+ *
+ * @param[in] key key from make_key
+ * @param[out] algorithm the chosen algorithm
+ * @return true if the key was found
+ */
+bool ConvTuner::lookup(const std::string &key, ConvLayer::ConvAlgorithm &algorithm)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    const auto decision = this->decisions_.find(key);
+    if (decision == this->decisions_.end())
+    {
+        return false;
+    }
+    this->num_hits_++;
+    algorithm = decision->second;
+    return true;
+}
+
+/**
+ * @brief returns the number of shapes tuned in this run
+ *
+ * @return std::size_t
+ */
+std::size_t ConvTuner::num_tuned(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->num_tuned_;
+}
+
+/**
+ * @brief returns the number of select calls answered without tuning
+ *
+ * @return std::size_t
+ */
+std::size_t ConvTuner::num_hits(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    return this->num_hits_;
+}
+
+/**
+ * @brief times every algorithm on the image and compares its output with DIRECT.
+ * @details each algorithm runs once to warm up, then repeatedly for at least
+ *          2 ms (max 1000 runs), the mean time per run is reported.
+ *
+ * @param[in] image height * width pixels
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] kernel kernel weights
+ * @param[in] stride stride as passed to convolute
+ * @param[in] zero_padding true if the image is zero padded
+ * @return std::vector<Timing> one entry per algorithm
+ */
+std::vector<ConvTuner::Timing> ConvTuner::benchmark(const uint8_t *image, const std::size_t height,
+                                                    const std::size_t width,
+                                                    const std::vector<std::vector<double>> &kernel,
+                                                    const uint8_t stride, const bool zero_padding)
+{
+    FeatureMap<uint8_t> reference;
+    ConvLayer::convolute(image, height, width, kernel, stride, zero_padding, reference, ConvLayer::ConvAlgorithm::DIRECT);
+
+    std::vector<Timing> timings;
+    FeatureMap<uint8_t> output;
+    for (const auto algorithm : CONV_ALGORITHMS)
+    {
+        ConvLayer::convolute(image, height, width, kernel, stride, zero_padding, output, algorithm);
+        const bool matches = output.height() == reference.height() && output.data() == reference.data();
+
+        std::size_t runs = 0;
+        const uint64_t start_ns = Profiler::now_ns();
+        uint64_t elapsed_ns = 0;
+        while (runs < 1000 && elapsed_ns < 2000000)
+        {
+            ConvLayer::convolute(image, height, width, kernel, stride, zero_padding, output, algorithm);
+            runs++;
+            elapsed_ns = Profiler::now_ns() - start_ns;
+        }
+        timings.push_back({algorithm, elapsed_ns * 1e-3 / runs, matches});
+    }
+    return timings;
+}
+
+/**
+ * @brief creates the key of a shape on this machine
+ *
+ * @param[in] height image height
+ * @param[in] width image width
+ * @param[in] kernel_size kernel size
+ * @param[in] stride stride as passed to convolute
+ * @param[in] zero_padding true if the image is zero padded
+ * @return std::string key without spaces
+ */
+std::string ConvTuner::make_key(const std::size_t height, const std::size_t width, const std::size_t kernel_size,
+                                const uint8_t stride, const bool zero_padding)
+{
+    std::ostringstream key;
+    key << cpu_signature() << ":" << height << "x" << width << ":k" << kernel_size
+        << ":s" << (int)stride << ":p" << (zero_padding ? 1 : 0);
+    return key.str();
+}
+
+/**
+ * @brief returns a signature of the CPU, the hex FNV-1a hash of the model name
+ *        from /proc/cpuinfo followed by the number of hardware threads
+ *
+ * @return const std::string&
+ */
+const std::string &ConvTuner::cpu_signature(void)
+{
+    static const std::string signature = []()
+    {
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line))
+        {
+            if (line.compare(0, 10, "model name") == 0)
+            {
+                model = line.substr(line.find(':') + 1);
+                break;
+            }
+        }
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char c : model)
+        {
+            hash ^= (uint8_t)c;
+            hash *= 1099511628211ULL;
+        }
+        std::ostringstream text;
+        text << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec
+             << "-t" << std::thread::hardware_concurrency();
+        return text.str();
+    }();
+    return signature;
+}
+
+/**
+ * @brief returns the name used in the cache file
+ *
+ * @param[in] algorithm
+ * @return const char*
+ */
+const char *ConvTuner::algorithm_name(const ConvLayer::ConvAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case ConvLayer::ConvAlgorithm::DIRECT:
+        return "direct";
+    case ConvLayer::ConvAlgorithm::IM2COL:
+        return "im2col";
+    case ConvLayer::ConvAlgorithm::TILED_PARALLEL:
+        return "tiled_parallel";
+    default:
+        return "auto";
+    }
+}
+
+/**
+ * @brief prints the result of benchmark
+ *
+ * @param[in] timings result of benchmark
+ * @param[in] ostream chosen output stream
+ */
+void ConvTuner::print_timings(const std::vector<Timing> &timings, std::ostream &ostream)
+{
+    for (const auto &timing : timings)
+    {
+        ostream << "  " << std::setfill(' ') << std::left << std::setw(16) << algorithm_name(timing.algorithm)
+                << std::right << std::setw(10) << std::fixed << std::setprecision(2) << timing.us << " us"
+                << (timing.matches ? "" : "  (output differs, not used)") << "\n";
+        ostream.unsetf(std::ios::fixed);
+        ostream << std::setprecision(6);
+    }
+}
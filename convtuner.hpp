@@ -0,0 +1,64 @@
+#ifndef CONVTUNER_HPP_
+#define CONVTUNER_HPP_
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <iostream>
+#include <unordered_map>
+
+#include "convlayer.hpp"
+
+#define CONV_TUNER_MAGIC "CONVTUNE1"
+
+/**
+ * @brief Class for choosing the fastest convolution algorithm per shape.
+ * @details the first time a shape (image size, kernel size, stride and
+ *          padding) is convoluted with ConvAlgorithm::AUTO every algorithm is
+ *          timed on the actual image, checked against DIRECT and the fastest
+ *          is remembered. With a cache file the decision is also appended to
+ *          the file, so later runs on the same machine skip the tuning.
+ *
+ *          The key includes a CPU signature (model name and number of
+ *          threads), decisions from another machine are never used.
+ *          File layout, one decision per line:
+ *          CONVTUNE1
+ *          <key> <algorithm>
+ */
+class ConvTuner
+{
+public:
+    struct Timing
+    {
+        ConvLayer::ConvAlgorithm algorithm;
+        double us;
+        bool matches;
+    };
+
+    static ConvTuner &instance(void);
+    int open(const char *filename);
+    ConvLayer::ConvAlgorithm select(const uint8_t *image, const std::size_t height, const std::size_t width,
+                                    const std::vector<std::vector<double>> &kernel,
+                                    const uint8_t stride, const bool zero_padding);
+    bool lookup(const std::string &key, ConvLayer::ConvAlgorithm &algorithm);
+    std::size_t num_tuned(void);
+    std::size_t num_hits(void);
+    static std::vector<Timing> benchmark(const uint8_t *image, const std::size_t height, const std::size_t width,
+                                         const std::vector<std::vector<double>> &kernel,
+                                         const uint8_t stride, const bool zero_padding);
+    static std::string make_key(const std::size_t height, const std::size_t width, const std::size_t kernel_size,
+                                const uint8_t stride, const bool zero_padding);
+    static const std::string &cpu_signature(void);
+    static const char *algorithm_name(const ConvLayer::ConvAlgorithm algorithm);
+    static void print_timings(const std::vector<Timing> &timings, std::ostream &ostream = std::cout);
+
+private:
+    ConvTuner(void) {}
+    std::mutex mutex_;
+    std::string filename_;
+    std::unordered_map<std::string, ConvLayer::ConvAlgorithm> decisions_;
+    std::size_t num_tuned_ = 0;
+    std::size_t num_hits_ = 0;
+};
+
+#endif /* CONVTUNER_HPP_ */
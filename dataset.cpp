@@ -0,0 +1,244 @@
+#include "dataset.hpp"
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief creates an empty owned dataset with fixed row sizes
+ *
+ * @param[in] num_inputs values per input row
+ * @param[in] num_outputs values per target row
+ */
+Dataset::Dataset(const std::size_t num_inputs, const std::size_t num_outputs)
+    : num_inputs_(num_inputs), num_outputs_(num_outputs)
+{
+}
+
+/**
+ * @brief copies rows of vectors into owned storage, the row sizes are taken
+ *        from the first row
+ *
+ * @param[in] inputs one input row per sample
+ * @param[in] targets one target row per sample
+ * @return int 0 if no errors, 1 if the number of rows differ, 2 if the rows
+ *         don't all have the same size. The dataset is empty after an error.
+ */
+int Dataset::assign(const std::vector<std::vector<double>> &inputs,
+                    const std::vector<std::vector<double>> &targets)
+{
+    this->clear();
+    this->num_inputs_ = inputs.empty() ? 0 : inputs[0].size();
+    this->num_outputs_ = targets.empty() ? 0 : targets[0].size();
+    if (inputs.size() != targets.size())
+    {
+        return 1;
+    }
+    this->reserve(inputs.size());
+    for (std::size_t i = 0; i < inputs.size(); i++)
+    {
+        if (this->append(inputs[i], targets[i]) != 0)
+        {
+            this->clear();
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief uses arrays owned by the caller, they must stay valid and unchanged
+ *        while the dataset (or a copy of it) uses them
+ *
+ * @param[in] inputs size x num_inputs values
+ * @param[in] targets size x num_outputs values
+ * @param[in] size number of samples
+ * @param[in] num_inputs values per input row
+ * @param[in] num_outputs values per target row
+ */
+void Dataset::borrow(const double *inputs, const double *targets, const std::size_t size,
+                     const std::size_t num_inputs, const std::size_t num_outputs)
+{
+    this->inputs_.clear();
+    this->inputs_.shrink_to_fit();
+    this->targets_.clear();
+    this->targets_.shrink_to_fit();
+    this->mapping_.reset();
+    this->borrowed_inputs_ = inputs;
+    this->borrowed_targets_ = targets;
+    this->size_ = inputs == nullptr ? 0 : size;
+    this->num_inputs_ = num_inputs;
+    this->num_outputs_ = num_outputs;
+}
+
+/**
+ * @brief returns a dataset that borrows the samples of this one, valid until
+ *        this dataset is changed or destroyed
+ *
+ * @return Dataset
+ */
+Dataset Dataset::view(void) const
+{
+    Dataset view;
+    view.borrow(this->inputs(), this->targets(), this->size_, this->num_inputs_, this->num_outputs_);
+    view.mapping_ = this->mapping_;
+    return view;
+}
+
+/**
+ * @brief adds a sample at the end, a borrowed dataset is copied into owned
+ *        storage first (once)
+ *
+ * @param[in] input num_inputs values
+ * @param[in] target num_outputs values
+ * @return int 0 if no errors
+ */
+int Dataset::append(const double *input, const double *target)
+{
+    this->make_owned();
+    this->inputs_.insert(this->inputs_.end(), input, input + this->num_inputs_);
+    this->targets_.insert(this->targets_.end(), target, target + this->num_outputs_);
+    this->size_++;
+    return 0;
+}
+
+/**
+ * @brief adds a sample at the end
+ *
+ * @param[in] input num_inputs values
+ * @param[in] target num_outputs values
+ * @return int 0 if no errors, 1 if a row has the wrong size
+ */
+int Dataset::append(const std::vector<double> &input, const std::vector<double> &target)
+{
+    if (input.size() != this->num_inputs_ || target.size() != this->num_outputs_)
+    {
+        return 1;
+    }
+    return this->append(input.data(), target.data());
+}
+
+/**
+ * @brief reserves owned storage for size samples
+ *
+ * @param[in] size number of samples
+ */
+void Dataset::reserve(const std::size_t size)
+{
+    this->make_owned();
+    this->inputs_.reserve(size * this->num_inputs_);
+    this->targets_.reserve(size * this->num_outputs_);
+}
+
+/**
+ * @brief removes every sample, the row sizes are kept
+ *
+ */
+void Dataset::clear(void)
+{
+    this->inputs_.clear();
+    this->targets_.clear();
+    this->borrowed_inputs_ = nullptr;
+    this->borrowed_targets_ = nullptr;
+    this->mapping_.reset();
+    this->size_ = 0;
+}
+
+/**
+ * @brief writes the samples to a file that map() can use without copying
+ *
+ * @param[in] filename path to the file
+ * @return int 0 if no errors, 1 if the file can't be written
+ */
+int Dataset::save(const char *filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        return 1;
+    }
+    const uint64_t header[4] = {DATASET_MAGIC, this->size_, this->num_inputs_, this->num_outputs_};
+    file.write((const char *)header, sizeof(header));
+    file.write((const char *)this->inputs(), this->size_ * this->num_inputs_ * sizeof(double));
+    file.write((const char *)this->targets(), this->size_ * this->num_outputs_ * sizeof(double));
+    return file.good() ? 0 : 1;
+}
+
+/**
+ * @brief borrows the samples of a file written by save() through a read-only
+ *        mmap, the file is unmapped when the last dataset using it is gone
+ *
+ * @param[in] filename path to the file
+ * @return int 0 if no errors, 1 if the file can't be opened or mapped,
+ *         2 if it is not a dataset or cut short
+ */
+int Dataset::map(const char *filename)
+{
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        ::close(fd);
+        return 1;
+    }
+    const std::size_t map_size = file_stat.st_size;
+    if (map_size < 4 * sizeof(uint64_t))
+    {
+        ::close(fd);
+        return 2;
+    }
+    void *map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        return 1;
+    }
+    std::shared_ptr<const void> mapping(map, [map_size](const void *pointer)
+                                        { munmap((void *)pointer, map_size); });
+
+    const uint64_t *header = (const uint64_t *)map;
+    const uint64_t size = header[1];
+    const uint64_t num_inputs = header[2];
+    const uint64_t num_outputs = header[3];
+    const std::size_t num_values = (map_size - 4 * sizeof(uint64_t)) / sizeof(double);
+    if (header[0] != DATASET_MAGIC || (num_inputs + num_outputs > 0 && size > num_values / (num_inputs + num_outputs)))
+    {
+        return 2;
+    }
+    const double *inputs = (const double *)(header + 4);
+    this->borrow(inputs, inputs + size * num_inputs, size, num_inputs, num_outputs);
+    this->mapping_ = mapping;
+    return 0;
+}
+
+/**
+ * @brief returns the bytes of owned storage
+ *
+ * @return std::size_t
+ */
+std::size_t Dataset::memory_usage(void) const
+{
+    return (this->inputs_.capacity() + this->targets_.capacity()) * sizeof(double);
+}
+
+/**
+ * @brief copies borrowed samples into owned storage
+ *
+ */
+void Dataset::make_owned(void)
+{
+    if (this->owned())
+    {
+        return;
+    }
+    this->inputs_.assign(this->borrowed_inputs_, this->borrowed_inputs_ + this->size_ * this->num_inputs_);
+    this->targets_.assign(this->borrowed_targets_, this->borrowed_targets_ + this->size_ * this->num_outputs_);
+    this->borrowed_inputs_ = nullptr;
+    this->borrowed_targets_ = nullptr;
+    this->mapping_.reset();
+}
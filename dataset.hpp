@@ -0,0 +1,70 @@
+#ifndef DATASET_HPP_
+#define DATASET_HPP_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#define DATASET_MAGIC 0x3130415441444e4eULL
+
+/**
+ * @brief Class for training samples stored in two contiguous row-major
+ *        matrices, inputs (size x num_inputs) and targets (size x num_outputs).
+ * @details the storage is either owned by the dataset or borrowed from the
+ *          caller (e.g. arrays of another dataset, a memory mapped file from
+ *          map(), or buffers filled by a producer). A borrowed dataset is
+ *          never copied until a sample is appended, then it becomes owned.
+ *          Appending to an owned dataset is amortized O(1) per sample.
+ *
+ *          Copying a dataset copies owned storage and shares borrowed storage,
+ *          use view() to pass an owned dataset on without copying it.
+ *
+ *          File layout of save() and map(), every field 8 bytes:
+ *          [magic][size][num_inputs][num_outputs][inputs double...][targets double...]
+ *
+ * @param[in] num_inputs values per input row
+ * @param[in] num_outputs values per target row
+ */
+class Dataset
+{
+public:
+    Dataset(void) {}
+    Dataset(const std::size_t num_inputs, const std::size_t num_outputs);
+    ~Dataset() {}
+    int assign(const std::vector<std::vector<double>> &inputs,
+               const std::vector<std::vector<double>> &targets);
+    void borrow(const double *inputs, const double *targets, const std::size_t size,
+                const std::size_t num_inputs, const std::size_t num_outputs);
+    Dataset view(void) const;
+    int append(const double *input, const double *target);
+    int append(const std::vector<double> &input, const std::vector<double> &target);
+    void reserve(const std::size_t size);
+    void clear(void);
+    int save(const char *filename) const;
+    int map(const char *filename);
+
+    std::size_t size(void) const { return this->size_; }
+    std::size_t num_inputs(void) const { return this->num_inputs_; }
+    std::size_t num_outputs(void) const { return this->num_outputs_; }
+    bool owned(void) const { return this->borrowed_inputs_ == nullptr; }
+    const double *input(const std::size_t index) const { return this->inputs() + index * this->num_inputs_; }
+    const double *target(const std::size_t index) const { return this->targets() + index * this->num_outputs_; }
+    std::size_t memory_usage(void) const;
+
+private:
+    std::size_t size_ = 0;
+    std::size_t num_inputs_ = 0;
+    std::size_t num_outputs_ = 0;
+    std::vector<double> inputs_;
+    std::vector<double> targets_;
+    const double *borrowed_inputs_ = nullptr;
+    const double *borrowed_targets_ = nullptr;
+    std::shared_ptr<const void> mapping_;
+
+    const double *inputs(void) const { return this->owned() ? this->inputs_.data() : this->borrowed_inputs_; }
+    const double *targets(void) const { return this->owned() ? this->targets_.data() : this->borrowed_targets_; }
+    void make_owned(void);
+};
+
+#endif /* DATASET_HPP_ */
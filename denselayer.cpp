@@ -1,4 +1,7 @@
 #include "denselayer.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+#include <functional>
 
 
 /**
@@ -51,6 +54,44 @@ std::size_t DenseLayer::num_weights(void) const
     }
 }
 
+/**
+ * @brief returns the number of floating point operations in one feedforward
+ *        of the dense layer, used by the profiler.
+ *
+ * @return number of flops.
+ */
+uint64_t DenseLayer::flops(void) const
+{
+    return 2 * this->num_nodes() * this->num_weights() + this->num_nodes();
+}
+
+/**
+ * @brief returns the number of bytes read and written in one feedforward
+ *        of the dense layer (weights, bias, input and output), used by the profiler.
+ *
+ * @return number of bytes.
+ */
+uint64_t DenseLayer::bytes(void) const
+{
+    return sizeof(double) * (this->num_nodes() * this->num_weights() + 2 * this->num_nodes() + this->num_weights());
+}
+
+/**
+ * @brief returns the bytes allocated by the layer, the sparse input index
+ *        is counted as data
+ *
+ * @return MemoryTracker::Usage
+ */
+MemoryTracker::Usage DenseLayer::memory_usage(void) const
+{
+    MemoryTracker::Usage usage;
+    usage.parameters = MemoryTracker::bytes(this->weights) + MemoryTracker::bytes(this->bias);
+    usage.activations = MemoryTracker::bytes(this->output);
+    usage.errors = MemoryTracker::bytes(this->error);
+    usage.data = MemoryTracker::bytes(this->nonzero_index);
+    return usage;
+}
+
 /**
  * @brief sets the desired activation function for selected dense layer.
  *
@@ -61,6 +102,18 @@ void DenseLayer::set_activation(const activation_option ao)
     this->ao = ao;
 }
 
+/**
+ * @brief sets the input density below which feedforward and optimize only
+ *        visit the non-zero inputs.
+ *
+ * @details the density is measured for every call, 0.0 disables the sparse path.
+ * @param[in] threshold fraction of non-zero inputs (0.0 - 1.0)
+ */
+void DenseLayer::set_sparse_threshold(const double threshold)
+{
+    this->sparse_threshold = threshold;
+}
+
 /**
  * @brief Erases all the elements in the vector containers for selected dense layer
  *
@@ -71,29 +124,78 @@ void DenseLayer::clear(void)
     this->error.clear();
     this->bias.clear();
     this->weights.clear();
+    this->nonzero_index.clear();
 }
 
 /**
  * @brief sets the size of all the elements in the vector containers for selected dense layer
  *
+ * @details every value is set to 0, the weights and biases are drawn by init_weights.
  * @param[in] num_nodes number of nodes
  * @param[in] num_weights number of weights per node
  */
 void DenseLayer::resize(const std::size_t num_nodes,
                          const std::size_t num_weights)
 {
-    this->output.resize(num_nodes, 0.0);
-    this->error.resize(num_nodes, 0.0);
-    this->bias.resize(num_nodes, 0.0);
-    this->weights.resize(num_nodes, std::vector<double>(num_weights, 0.0));
+    this->output.assign(num_nodes, 0.0);
+    this->error.assign(num_nodes, 0.0);
+    this->bias.assign(num_nodes, 0.0);
+    this->weights.assign(num_nodes, std::vector<double>(num_weights, 0.0));
+    this->nonzero_index.reserve(num_weights);
+}
 
-    for (std::size_t i = 0; i < num_nodes; ++i)
+/**
+ * @brief sets new weights and bias for the nodes in [first_node, last_node).
+ *
+ * @details every node draws from its own random stream (seed, layer_index, node),
+ *          so the result is the same however the nodes are split between threads.
+ *          UNIFORM: weights and bias in [0, 1)
+ *          XAVIER:  weights in +-sqrt(6 / (fan_in + fan_out)), bias 0
+ *          HE:      weights in +-sqrt(6 / fan_in), bias 0
+ *
+ * @param[in] io initialisation scheme
+ * @param[in] seed seed of the run
+ * @param[in] layer_index index of the layer in the network
+ * @param[in] fan_out number of nodes in the next layer (0 for the output layer)
+ * @param[in] first_node first node to initialise
+ * @param[in] last_node one past the last node to initialise
+ */
+void DenseLayer::init_weights(const init_option io,
+                              const uint64_t seed,
+                              const uint64_t layer_index,
+                              const std::size_t fan_out,
+                              const std::size_t first_node,
+                              const std::size_t last_node)
+{
+    const std::size_t fan_in = this->num_weights();
+    double limit = 1.0;
+    if (io == init_option::XAVIER)
+    {
+        limit = sqrt(6.0 / std::max<std::size_t>(1, fan_in + fan_out));
+    }
+    else if (io == init_option::HE)
     {
-        this->bias[i] = this->get_random();
+        limit = sqrt(6.0 / std::max<std::size_t>(1, fan_in));
+    }
 
-        for (std::size_t j = 0; j < num_weights; ++j)
+    for (std::size_t i = first_node; i < this->num_nodes() && i < last_node; i++)
+    {
+        Rng rng(seed, (layer_index << 32) | i);
+        if (io == init_option::UNIFORM)
         {
-            this->weights[i][j] = this->get_random();
+            this->bias[i] = rng.uniform();
+            for (auto &weight : this->weights[i])
+            {
+                weight = rng.uniform();
+            }
+        }
+        else
+        {
+            this->bias[i] = 0.0;
+            for (auto &weight : this->weights[i])
+            {
+                weight = rng.uniform(-limit, limit);
+            }
         }
     }
 }
@@ -110,14 +212,61 @@ void DenseLayer::resize(const std::size_t num_nodes,
  */
 void DenseLayer::feedforward(const std::vector<double> &input)
 {
-    for (std::size_t i = 0; i < this->num_nodes(); i++)
+    this->feedforward(input.data(), input.size());
+}
+
+/**
+ * @brief calculates new output for each node from a contiguous input buffer,
+ *        see feedforward(const std::vector<double> &input).
+ *
+ * @param[in] input indata from training data or previous layer
+ * @param[in] num_inputs number of values in input
+ */
+void DenseLayer::feedforward(const double *input, const std::size_t num_inputs)
+{
+    this->feedforward(input, num_inputs, this->output.data(), this->nonzero_index);
+}
+
+/**
+ * @brief calculates the output of each node into a caller owned buffer and
+ *        leaves the layer untouched, so several threads can share the weights.
+ *
+ * @param[in] input indata from training data or previous layer
+ * @param[in] num_inputs number of values in input
+ * @param[out] output num_nodes() output values
+ * @param[in,out] nonzero_index scratch buffer for the sparse path
+ */
+void DenseLayer::feedforward(const double *input, const std::size_t num_inputs,
+                             double *output, std::vector<std::size_t> &nonzero_index) const
+{
+    if (this->gather_nonzero(input, num_inputs, nonzero_index))
     {
-        double sum = bias[i];
-        for (std::size_t j = 0; j < this->num_weights() && j < input.size(); j++)
+        for (std::size_t i = 0; i < this->num_nodes(); i++)
         {
-            sum += input[j] * this->weights[i][j];
+            double sum = bias[i];
+            const std::vector<double> &node_weights = this->weights[i];
+            for (const auto j : nonzero_index)
+            {
+                sum += input[j] * node_weights[j];
+            }
+            output[i] = this->activation(sum);
         }
-        this->output[i] = this->activation(sum);
+        return;
+    }
+
+    const Kernels &kernels = Kernels::instance();
+    const std::size_t n = std::min(this->num_weights(), num_inputs);
+    for (std::size_t i = 0; i < this->num_nodes(); i++)
+    {
+        output[i] = kernels.dot(input, this->weights[i].data(), n, bias[i]);
+    }
+    if (this->ao == activation_option::TANH)
+    {
+        kernels.apply_tanh(output, this->num_nodes());
+    }
+    else
+    {
+        kernels.apply_relu(output, this->num_nodes());
     }
 }
 
@@ -139,11 +288,35 @@ void DenseLayer::feedforward(const std::vector<double> &input)
  * @param[in] reference target value from training data (yref)
  */
 void DenseLayer::backpropagate(const std::vector<double> &reference)
+{
+    this->backpropagate(reference.data());
+}
+
+/**
+ * @brief calculates the error for each node in output layer from a contiguous
+ *        reference buffer, see backpropagate(const std::vector<double> &reference).
+ *
+ * @param[in] reference target value from training data (yref), num_nodes() values
+ */
+void DenseLayer::backpropagate(const double *reference)
+{
+    this->backpropagate(reference, this->output.data(), this->error.data());
+}
+
+/**
+ * @brief calculates the error for each node in output layer from caller owned
+ *        buffers, see backpropagate(const std::vector<double> &reference).
+ *
+ * @param[in] reference target value from training data (yref), num_nodes() values
+ * @param[in] output output of this layer from feedforward
+ * @param[out] error num_nodes() error values
+ */
+void DenseLayer::backpropagate(const double *reference, const double *output, double *error) const
 {
     for (std::size_t i = 0; i < this->num_nodes(); i++)
     {
-        double dev = reference[i] - this->output[i];
-        this->error[i] = dev * delta_activation(this->output[i]);
+        double dev = reference[i] - output[i];
+        error[i] = dev * delta_activation(output[i]);
     }
 }
 
@@ -164,16 +337,31 @@ void DenseLayer::backpropagate(const std::vector<double> &reference)
  */
 void DenseLayer::backpropagate(const DenseLayer &next_layer)
 {
+    this->backpropagate(next_layer, next_layer.error.data(), this->output.data(), this->error.data());
+}
+
+/**
+ * @brief calculates the error for each node in a dense layer from caller owned
+ *        buffers, see backpropagate(const DenseLayer &next_layer).
+ *
+ * @param[in] next_layer next dense layer (only the weights are used)
+ * @param[in] next_error error of the next layer
+ * @param[in] output output of this layer from feedforward
+ * @param[out] error num_nodes() error values
+ */
+void DenseLayer::backpropagate(const DenseLayer &next_layer, const double *next_error,
+                               const double *output, double *error) const
+{
+    // error = sum of next_error[j] * row j of the next layer's weights, row by row
+    const Kernels &kernels = Kernels::instance();
+    std::fill(error, error + this->num_nodes(), 0.0);
+    for (std::size_t j = 0; j < next_layer.num_nodes(); j++)
+    {
+        kernels.axpy(error, next_error[j], next_layer.weights[j].data(), this->num_nodes());
+    }
     for (std::size_t i = 0; i < this->num_nodes(); i++)
     {
-        double dev = 0.0;
-        {
-            for (std::size_t j = 0; j < next_layer.num_nodes(); j++)
-            {
-                dev += next_layer.error[j] * next_layer.weights[j][i];
-            }
-            this->error[i] = dev * this->delta_activation(this->output[i]);
-        }
+        error[i] *= this->delta_activation(output[i]);
     }
 }
 
@@ -196,23 +384,154 @@ void DenseLayer::backpropagate(const DenseLayer &next_layer)
 void DenseLayer::optimize(const std::vector<double> &input,
                            const double learning_rate)
 {
+    this->optimize(input.data(), input.size(), learning_rate);
+}
+
+/**
+ * @brief calculates new bias and new weights from a contiguous input buffer,
+ *        see optimize(const std::vector<double> &input, const double learning_rate).
+ *
+ * @param[in] input in-data from training data or previous layer
+ * @param[in] num_inputs number of values in input
+ * @param[in] learning_rate amount of error adjustment
+ */
+void DenseLayer::optimize(const double *input, const std::size_t num_inputs,
+                          const double learning_rate)
+{
+    this->optimize(input, num_inputs, this->error.data(), learning_rate, this->nonzero_index);
+}
+
+/**
+ * @brief calculates new bias and new weights from a caller owned error buffer.
+ * @details only the weights and biases are written, so several threads may
+ *          call this on the same layer (Hogwild). Updates that collide are
+ *          then simply lost, which SGD tolerates when the updates are sparse.
+ *
+ * @param[in] input in-data from training data or previous layer
+ * @param[in] num_inputs number of values in input
+ * @param[in] error error of this layer from backpropagate
+ * @param[in] learning_rate amount of error adjustment
+ * @param[in,out] nonzero_index scratch buffer for the sparse path
+ */
+void DenseLayer::optimize(const double *input, const std::size_t num_inputs, const double *error,
+                          const double learning_rate, std::vector<std::size_t> &nonzero_index)
+{
+    if (this->gather_nonzero(input, num_inputs, nonzero_index))
+    {
+        for (std::size_t i = 0; i < this->num_nodes(); i++)
+        {
+            const double step = error[i] * learning_rate;
+            this->bias[i] += step;
+            std::vector<double> &node_weights = this->weights[i];
+            for (const auto j : nonzero_index)
+            {
+                node_weights[j] += step * input[j];
+            }
+        }
+        return;
+    }
+
+    const Kernels &kernels = Kernels::instance();
+    const std::size_t n = std::min(this->num_weights(), num_inputs);
     for (std::size_t i = 0; i < this->num_nodes(); i++)
     {
-        this->bias[i] += this->error[i] * learning_rate;
-        for (std::size_t j = 0; j < this->num_weights() && j < input.size(); j++)
+        this->bias[i] += error[i] * learning_rate;
+        kernels.axpy(this->weights[i].data(), error[i] * learning_rate, input, n);
+    }
+}
+/**
+ * @brief sets every weight with a magnitude below the threshold to zero
+ *
+ * @param[in] threshold smallest magnitude that is kept
+ * @return number of weights that are zero after pruning
+ */
+std::size_t DenseLayer::prune(const double threshold)
+{
+    std::size_t num_zero = 0;
+    for (auto &node_weights : this->weights)
+    {
+        for (auto &weight : node_weights)
         {
-            this->weights[i][j] += this->error[i] * learning_rate * input[j];
+            if (fabs(weight) < threshold)
+            {
+                weight = 0.0;
+            }
+            num_zero += weight == 0.0 ? 1 : 0;
         }
     }
+    return num_zero;
 }
+
 /**
- * @brief returns a value beteween 0  and 1
+ * @brief keeps the largest weights (by magnitude) of the layer and sets
+ *        the rest to zero
  *
- * @return double
+ * @param[in] keep_fraction fraction of the weights to keep (0.0 - 1.0)
+ * @return number of weights that are zero after pruning
  */
-inline double DenseLayer::get_random(void)
+std::size_t DenseLayer::prune_top_k(const double keep_fraction)
 {
-    return (double)(std::rand()) / RAND_MAX;
+    std::vector<double> magnitudes;
+    magnitudes.reserve(this->num_nodes() * this->num_weights());
+    for (const auto &node_weights : this->weights)
+    {
+        for (const auto weight : node_weights)
+        {
+            magnitudes.push_back(fabs(weight));
+        }
+    }
+    const std::size_t num_keep = (std::size_t)(std::max(0.0, std::min(1.0, keep_fraction)) * magnitudes.size());
+    if (num_keep >= magnitudes.size())
+    {
+        return this->prune(0.0);
+    }
+    if (num_keep == 0)
+    {
+        return this->prune(INFINITY);
+    }
+    // the num_keep:th largest magnitude is the smallest one that is kept
+    std::nth_element(magnitudes.begin(), magnitudes.begin() + (num_keep - 1), magnitudes.end(), std::greater<double>());
+    return this->prune(magnitudes[num_keep - 1]);
+}
+
+/**
+ * @brief collects the index of every non-zero input as long as the input
+ *        is sparse enough for the sparse path to pay off.
+ *
+ * @details the scan stops as soon as the number of non-zero inputs reaches
+ *          the threshold, so dense inputs only pay for a partial scan.
+ *          A zero input gives a zero product in feedforward and a zero
+ *          weight update in optimize, so skipping it gives the same weights in
+ *          optimize. The sparse feedforward adds in index order, a dense sum
+ *          that adds in another order (e.g. in several vector lanes) may
+ *          differ from it in the last bits.
+ * @param[in] input indata from training data or previous layer
+ * @param[in] num_inputs number of values in input
+ * @param[out] nonzero_index index of every non-zero input
+ * @return true if the sparse path should be used
+ */
+bool DenseLayer::gather_nonzero(const double *input, std::size_t num_inputs,
+                                std::vector<std::size_t> &nonzero_index) const
+{
+    num_inputs = std::min(this->num_weights(), num_inputs);
+    const std::size_t max_nonzero = (std::size_t)(this->sparse_threshold * num_inputs);
+    nonzero_index.clear();
+    if (max_nonzero == 0)
+    {
+        return false;
+    }
+    for (std::size_t j = 0; j < num_inputs; j++)
+    {
+        if (input[j] != 0.0)
+        {
+            if (nonzero_index.size() == max_nonzero)
+            {
+                return false;
+            }
+            nonzero_index.push_back(j);
+        }
+    }
+    return true;
 }
 
 /**
@@ -227,7 +546,7 @@ inline double DenseLayer::get_random(void)
  * @param[in] sum
  * @return sum
  */
-inline double DenseLayer::activation(const double sum)
+inline double DenseLayer::activation(const double sum) const
 {
     if (this->ao == activation_option::TANH)
     {
@@ -249,7 +568,7 @@ inline double DenseLayer::activation(const double sum)
  * @param[in] output
  * @return output
  */
-inline double DenseLayer::delta_activation(const double output)
+inline double DenseLayer::delta_activation(const double output) const
 {
     if (this->ao == activation_option::TANH)
     {
@@ -6,12 +6,22 @@
 #include <iomanip>
 #include <cstdlib>
 #include <math.h>
+#include <cstdint>
+
+#include "rng.hpp"
+#include "memorytracker.hpp"
 
 enum class activation_option
 {
     RELU,
     TANH
 };
+enum class init_option
+{
+    UNIFORM,
+    XAVIER,
+    HE
+};
 enum class print_option
 {
     LITE,
@@ -37,21 +47,47 @@ public:
     ~DenseLayer();
     std::size_t num_nodes(void) const;
     std::size_t num_weights(void) const;
+    uint64_t flops(void) const;
+    uint64_t bytes(void) const;
+    MemoryTracker::Usage memory_usage(void) const;
     void set_activation(const activation_option ao = activation_option::TANH);
+    void set_sparse_threshold(const double threshold = 0.5);
     void clear(void);
     void resize(const std::size_t num_nodes,
                 const std::size_t num_weights);
+    void init_weights(const init_option io,
+                      const uint64_t seed,
+                      const uint64_t layer_index,
+                      const std::size_t fan_out,
+                      const std::size_t first_node = 0,
+                      const std::size_t last_node = SIZE_MAX);
     void feedforward(const std::vector<double> &input);
+    void feedforward(const double *input, const std::size_t num_inputs);
+    void feedforward(const double *input, const std::size_t num_inputs,
+                     double *output, std::vector<std::size_t> &nonzero_index) const;
     void backpropagate(const std::vector<double> &reference);
+    void backpropagate(const double *reference);
+    void backpropagate(const double *reference, const double *output, double *error) const;
     void backpropagate(const DenseLayer &next_layer);
+    void backpropagate(const DenseLayer &next_layer, const double *next_error,
+                       const double *output, double *error) const;
     void optimize(const std::vector<double> &input,
                   const double learning_rate);
+    void optimize(const double *input, const std::size_t num_inputs,
+                  const double learning_rate);
+    void optimize(const double *input, const std::size_t num_inputs, const double *error,
+                  const double learning_rate, std::vector<std::size_t> &nonzero_index);
+    std::size_t prune(const double threshold);
+    std::size_t prune_top_k(const double keep_fraction);
     void print(print_option po = print_option::LITE, std::ostream &ostream = std::cout);
 
 private: 
-    inline double get_random(void);
-    inline double activation(const double sum);
-    inline double delta_activation(const double output);
+    double sparse_threshold = 0.5;
+    std::vector<std::size_t> nonzero_index;
+    bool gather_nonzero(const double *input, std::size_t num_inputs,
+                        std::vector<std::size_t> &nonzero_index) const;
+    inline double activation(const double sum) const;
+    inline double delta_activation(const double output) const;
     double get_rounded(const double number,
                        const double threshold = 0.001);
 };
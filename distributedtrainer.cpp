@@ -0,0 +1,225 @@
+#include "distributedtrainer.hpp"
+#include "ringallreduce.hpp"
+#include <vector>
+#include <iostream>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/**
+ * @brief trains network with num_workers processes on localhost
+ *
+ * @param[in,out] network network with training data, replaced by the trained network
+ * @param[in] num_workers number of processes (at least 1)
+ * @param[in] num_epochs number of epochs
+ * @param[in] learning_rate amount of error adjustment
+ * @param[in] batch_size samples per weight update over all workers
+ * @param[out] stats statistics of worker 0, or nullptr
+ * @return int 0 if no errors, 1 if the sockets or processes can't be created,
+ *         2 if a worker failed, 3 if the result can't be loaded
+ */
+int DistributedTrainer::launch(NeuralNetwork &network,
+                               const std::size_t num_workers,
+                               const std::size_t num_epochs,
+                               const double learning_rate,
+                               const std::size_t batch_size,
+                               NeuralNetwork::DistributedTrainingStats *stats)
+{
+    const std::size_t n = num_workers == 0 ? 1 : num_workers;
+    // ring[r] connects worker r (ring[r][0]) to worker r + 1 (ring[r][1])
+    std::vector<int> fds;
+    std::vector<std::pair<int, int>> ring(n);
+    int result[2] = {-1, -1};
+    auto close_all = [&fds]()
+    {
+        for (const int fd : fds)
+        {
+            close(fd);
+        }
+        fds.clear();
+    };
+    for (auto &link : ring)
+    {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+        {
+            close_all();
+            return 1;
+        }
+        link = {pair[0], pair[1]};
+        fds.insert(fds.end(), pair, pair + 2);
+    }
+    if (pipe(result) != 0)
+    {
+        close_all();
+        return 1;
+    }
+    fds.insert(fds.end(), result, result + 2);
+
+    // buffered output would be written again by every worker
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> workers;
+    for (std::size_t rank = 0; rank < n; rank++)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            const int send_fd = ring[rank].first;
+            const int recv_fd = ring[(rank + n - 1) % n].second;
+            const int result_fd = rank == 0 ? result[1] : -1;
+            for (const int fd : fds)
+            {
+                if (fd != send_fd && fd != recv_fd && fd != result_fd)
+                {
+                    close(fd);
+                }
+            }
+            _exit(run_worker(network, rank, n, send_fd, recv_fd, result_fd, num_epochs, learning_rate, batch_size));
+        }
+        if (pid < 0)
+        {
+            break;
+        }
+        workers.push_back(pid);
+    }
+    const int result_fd = result[0];
+    for (const int fd : fds)
+    {
+        if (fd != result_fd)
+        {
+            close(fd);
+        }
+    }
+
+    // worker 0 answers with its return value, statistics and the trained network
+    int ret = workers.size() == n ? 0 : 1;
+    int32_t worker_ret = 0;
+    NeuralNetwork::DistributedTrainingStats worker_stats;
+    uint64_t size = 0;
+    std::vector<char> snapshot;
+    if (ret == 0)
+    {
+        if (read_all(result_fd, &worker_ret, sizeof(worker_ret)) != 0 ||
+            read_all(result_fd, &worker_stats, sizeof(worker_stats)) != 0 ||
+            read_all(result_fd, &size, sizeof(size)) != 0)
+        {
+            ret = 2;
+        }
+        else
+        {
+            snapshot.resize(size);
+            ret = worker_ret != 0 || read_all(result_fd, snapshot.data(), size) != 0 ? 2 : 0;
+        }
+    }
+    close(result_fd);
+
+    for (const pid_t pid : workers)
+    {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        if (ret == 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+        {
+            ret = 2;
+        }
+    }
+    if (ret != 0)
+    {
+        return ret;
+    }
+    std::size_t epoch = 0;
+    if (network.load_snapshot(snapshot.data(), snapshot.size(), epoch) != 0)
+    {
+        return 3;
+    }
+    if (stats != nullptr)
+    {
+        *stats = worker_stats;
+    }
+    return 0;
+}
+
+/**
+ * @brief runs in a forked worker, trains its shard and worker 0 sends the result
+ *
+ * @return int exit status, 0 if no errors
+ */
+int DistributedTrainer::run_worker(NeuralNetwork &network, const std::size_t rank, const std::size_t num_workers,
+                                   const int send_fd, const int recv_fd, const int result_fd,
+                                   const std::size_t num_epochs, const double learning_rate,
+                                   const std::size_t batch_size)
+{
+    RingAllreduce ring(rank, num_workers, send_fd, recv_fd);
+    NeuralNetwork::DistributedTrainingStats stats;
+    const int32_t ret = network.train_distributed(num_epochs, learning_rate, batch_size, ring, &stats);
+    if (result_fd < 0)
+    {
+        return ret;
+    }
+    std::vector<char> snapshot(ret == 0 ? network.snapshot_size() : 0);
+    if (ret == 0)
+    {
+        network.save_snapshot(snapshot.data(), num_epochs);
+    }
+    const uint64_t size = snapshot.size();
+    if (write_all(result_fd, &ret, sizeof(ret)) != 0 || write_all(result_fd, &stats, sizeof(stats)) != 0 ||
+        write_all(result_fd, &size, sizeof(size)) != 0 || write_all(result_fd, snapshot.data(), size) != 0)
+    {
+        return 1;
+    }
+    return ret;
+}
+
+/**
+ * @brief writes size bytes to a pipe or socket
+ *
+ * @return int 0 if no errors
+ */
+int DistributedTrainer::write_all(const int fd, const void *data, std::size_t size)
+{
+    const char *bytes = (const char *)data;
+    while (size > 0)
+    {
+        const ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return 1;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief reads size bytes from a pipe or socket
+ *
+ * @return int 0 if no errors, 1 if the other end closed early
+ */
+int DistributedTrainer::read_all(const int fd, void *data, std::size_t size)
+{
+    char *bytes = (char *)data;
+    while (size > 0)
+    {
+        const ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return 1;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return 0;
+}
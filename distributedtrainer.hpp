@@ -0,0 +1,39 @@
+#ifndef DISTRIBUTEDTRAINER_HPP_
+#define DISTRIBUTEDTRAINER_HPP_
+
+#include <cstddef>
+
+#include "neuralnetwork.hpp"
+
+/**
+ * @brief Class for launching NeuralNetwork::train_distributed on localhost.
+ * @details launch connects num_workers processes in a ring of Unix domain
+ *          socket pairs and forks them from the calling process, so every
+ *          worker starts with the network, its training data (shared copy on
+ *          write, not copied) and the state of the shuffle generator. Each
+ *          worker trains on its shard of every batch, worker 0 sends the
+ *          trained network back as a snapshot and the caller's network is
+ *          replaced by it, as if it had been trained with train_batched.
+ *
+ *          Workers on other hosts would use the same RingAllreduce with TCP
+ *          connections instead of the socket pairs.
+ */
+class DistributedTrainer
+{
+public:
+    static int launch(NeuralNetwork &network,
+                      const std::size_t num_workers,
+                      const std::size_t num_epochs,
+                      const double learning_rate,
+                      const std::size_t batch_size = 32,
+                      NeuralNetwork::DistributedTrainingStats *stats = nullptr);
+
+private:
+    static int run_worker(NeuralNetwork &network, const std::size_t rank, const std::size_t num_workers,
+                          const int send_fd, const int recv_fd, const int result_fd,
+                          const std::size_t num_epochs, const double learning_rate, const std::size_t batch_size);
+    static int write_all(const int fd, const void *data, std::size_t size);
+    static int read_all(const int fd, void *data, std::size_t size);
+};
+
+#endif /* DISTRIBUTEDTRAINER_HPP_ */
@@ -0,0 +1,99 @@
+#include "evaluation.hpp"
+#include <iomanip>
+
+/**
+ * @brief creates an empty result for a network with num_outputs outputs
+ *
+ * @param[in] num_outputs number of network outputs
+ * @param[in] threshold outputs at or above the threshold count as 1
+ */
+EvaluationResult::EvaluationResult(const std::size_t num_outputs, const double threshold)
+    : threshold(threshold), outputs(num_outputs)
+{
+}
+
+/**
+ * @brief adds one sample, the squared errors are summed until finish
+ *
+ * @param[in] output prediction, one value per output
+ * @param[in] target reference, one value per output
+ */
+void EvaluationResult::add(const double *output, const double *target)
+{
+    bool correct = true;
+    for (std::size_t k = 0; k < this->outputs.size(); k++)
+    {
+        OutputStats &stats = this->outputs[k];
+        const double dev = target[k] - output[k];
+        stats.mean_squared_error += dev * dev;
+
+        const bool predicted = output[k] >= this->threshold;
+        const bool expected = target[k] >= this->threshold;
+        if (predicted && expected)
+        {
+            stats.true_positives++;
+        }
+        else if (predicted)
+        {
+            stats.false_positives++;
+        }
+        else if (expected)
+        {
+            stats.false_negatives++;
+        }
+        else
+        {
+            stats.true_negatives++;
+        }
+        correct = correct && predicted == expected;
+    }
+    this->num_samples++;
+    this->num_correct += correct ? 1 : 0;
+}
+
+/**
+ * @brief turns the sums into means and sets the throughput
+ *
+ * @param[in] seconds time spent on the forward passes
+ */
+void EvaluationResult::finish(const double seconds)
+{
+    double sum = 0.0;
+    for (auto &stats : this->outputs)
+    {
+        sum += stats.mean_squared_error;
+        stats.mean_squared_error = this->num_samples > 0 ? stats.mean_squared_error / this->num_samples : 0.0;
+    }
+    const std::size_t num_values = this->num_samples * this->outputs.size();
+    this->loss = num_values > 0 ? sum / num_values : 0.0;
+    this->accuracy = this->num_samples > 0 ? (double)this->num_correct / this->num_samples : 0.0;
+    this->seconds = seconds;
+    this->samples_per_second = seconds > 0.0 ? this->num_samples / seconds : 0.0;
+}
+
+/**
+ * @brief prints the summary and a row per output
+ *
+ * @param[in] ostream chosen output stream
+ */
+void EvaluationResult::print(std::ostream &ostream) const
+{
+    const std::ios::fmtflags flags = ostream.flags();
+    const std::streamsize precision = ostream.precision();
+    const char fill = ostream.fill();
+    ostream << std::setfill(' ') << "samples: " << this->num_samples << ", accuracy: "
+            << std::fixed << std::setprecision(2) << this->accuracy * 100.0 << " %, loss (mse): " << std::scientific << std::setprecision(3) << this->loss
+            << ", " << std::fixed << std::setprecision(0) << this->samples_per_second << " samples/s\n";
+    ostream << " output         mse      tp      fp      tn      fn\n";
+    for (std::size_t k = 0; k < this->outputs.size(); k++)
+    {
+        const OutputStats &stats = this->outputs[k];
+        ostream << std::setw(7) << k << std::scientific << std::setprecision(3) << std::setw(12)
+                << stats.mean_squared_error << std::setw(8) << stats.true_positives << std::setw(8)
+                << stats.false_positives << std::setw(8) << stats.true_negatives << std::setw(8)
+                << stats.false_negatives << "\n";
+    }
+    ostream.flags(flags);
+    ostream.precision(precision);
+    ostream.fill(fill);
+}
@@ -0,0 +1,48 @@
+#ifndef EVALUATION_HPP_
+#define EVALUATION_HPP_
+
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+/**
+ * @brief Class for the metrics of a network on a dataset.
+ * @details filled by NeuralNetwork::evaluate, one add() per sample with the
+ *          prediction from the only forward pass of that sample. Outputs and
+ *          targets are turned into bits with the threshold, a sample is
+ *          correct when every bit matches, and every output keeps its own
+ *          squared error and binary confusion counts.
+ *
+ * @param[in] num_outputs number of network outputs
+ * @param[in] threshold outputs at or above the threshold count as 1
+ */
+class EvaluationResult
+{
+public:
+    struct OutputStats
+    {
+        double mean_squared_error = 0.0;
+        std::size_t true_positives = 0;
+        std::size_t false_positives = 0;
+        std::size_t true_negatives = 0;
+        std::size_t false_negatives = 0;
+    };
+
+    std::size_t num_samples = 0;
+    std::size_t num_correct = 0;
+    double accuracy = 0.0;
+    double loss = 0.0;
+    double seconds = 0.0;
+    double samples_per_second = 0.0;
+    double threshold = 0.5;
+    std::vector<OutputStats> outputs;
+
+    EvaluationResult(void) {}
+    EvaluationResult(const std::size_t num_outputs, const double threshold = 0.5);
+    ~EvaluationResult() {}
+    void add(const double *output, const double *target);
+    void finish(const double seconds);
+    void print(std::ostream &ostream = std::cout) const;
+};
+
+#endif /* EVALUATION_HPP_ */
@@ -0,0 +1,326 @@
+#include "featurecache.hpp"
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Construct a new FeatureCache::FeatureCache object and opens the cache file
+ *
+ * @param[in] filename path to the cache file, created if missing
+ */
+FeatureCache::FeatureCache(const char *filename)
+{
+    this->open(filename);
+}
+
+/**
+ * @brief Destructor unmaps and closes the cache file
+ *
+ */
+FeatureCache::~FeatureCache()
+{
+    this->close();
+}
+
+/**
+ * @brief opens (or creates) a cache file and indexes every complete record.
+ *
+ * @param[in] filename path to the cache file
+ * @return int 0 if no errors, 5 if the file can't be opened, 6 if it is not a feature cache
+ */
+int FeatureCache::open(const char *filename)
+{
+    this->close();
+    this->fd_ = ::open(filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (this->fd_ < 0)
+    {
+        return 5;
+    }
+
+    struct stat st;
+    if (fstat(this->fd_, &st) != 0)
+    {
+        this->close();
+        return 5;
+    }
+    std::size_t file_size = st.st_size;
+    const std::size_t magic_size = sizeof(FEATURE_CACHE_MAGIC) - 1;
+    if (file_size == 0)
+    {
+        if (write(this->fd_, FEATURE_CACHE_MAGIC, magic_size) != (ssize_t)magic_size)
+        {
+            this->close();
+            return 5;
+        }
+        return 0;
+    }
+    if (file_size < magic_size)
+    {
+        this->close();
+        return 6;
+    }
+
+    void *map = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, this->fd_, 0);
+    if (map == MAP_FAILED)
+    {
+        this->close();
+        return 5;
+    }
+    this->map_ = (const char *)map;
+    this->map_size_ = file_size;
+    if (std::memcmp(this->map_, FEATURE_CACHE_MAGIC, magic_size) != 0)
+    {
+        this->close();
+        return 6;
+    }
+
+    std::size_t offset = magic_size;
+    while (offset + sizeof(RecordHeader) <= file_size)
+    {
+        RecordHeader header;
+        std::memcpy(&header, this->map_ + offset, sizeof(header));
+        const std::size_t record_size = sizeof(RecordHeader) + header.num_features * sizeof(double);
+        if (offset + record_size > file_size)
+        {
+            break;
+        }
+        this->index_[header.key] = {(const double *)(this->map_ + offset + sizeof(RecordHeader)), header.num_features,
+                                    header.extract_us};
+        offset += record_size;
+    }
+
+    // drop a record that was cut short so the next append starts aligned
+    if (offset < file_size)
+    {
+        if (ftruncate(this->fd_, offset) != 0)
+        {
+            this->close();
+            return 5;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief unmaps and closes the cache file and erases the index
+ *
+ */
+void FeatureCache::close(void)
+{
+    if (this->map_ != nullptr)
+    {
+        munmap((void *)this->map_, this->map_size_);
+        this->map_ = nullptr;
+        this->map_size_ = 0;
+    }
+    if (this->fd_ >= 0)
+    {
+        ::close(this->fd_);
+        this->fd_ = -1;
+    }
+    this->index_.clear();
+    this->appended_.clear();
+}
+
+/**
+ * @brief returns the features of a bitmap, from the cache if they are there,
+ *        otherwise by running the pipeline and appending the result.
+ *
+ * @details a hit only reads the file to hash it, the bitmap is never decoded
+ *          and no convolution is done. The pipeline time stored with the
+ *          record minus the time of the hit is added to saved_seconds.
+ * @param[in] bmp_filename path and file name to bitmap
+ * @param[in] config pipeline settings
+ * @param[out] features flattened features
+ * @return int 0 if no errors, otherwise the error from ConvLayer::read_file/extract_features
+ */
+int FeatureCache::get_features(const char *bmp_filename, const ConvLayer::PipelineConfig &config,
+                               std::vector<double> &features)
+{
+    const uint64_t start_ns = Profiler::now_ns();
+    std::string content;
+    int ret = ConvLayer::read_file(bmp_filename, content);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    const uint64_t key = make_key(content, config);
+    uint32_t extract_us = 0;
+    if (this->lookup(key, features, &extract_us))
+    {
+        this->hits_++;
+        const double hit_seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+        this->saved_seconds_ += std::max(0.0, extract_us * 1e-6 - hit_seconds);
+        return 0;
+    }
+    this->misses_++;
+    ret = ConvLayer::extract_features(content, config, features);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    const uint64_t elapsed_us = (Profiler::now_ns() - start_ns) / 1000;
+    this->append(key, features, (uint32_t)std::min<uint64_t>(elapsed_us, UINT32_MAX));
+    return 0;
+}
+
+/**
+ * @brief copies the features stored under key
+ *
+ * @param[in] key cache key from make_key
+ * @param[out] features flattened features
+ * @param[out] extract_us if not nullptr, the pipeline time stored with the record
+ * @return true if the key was found
+ */
+bool FeatureCache::lookup(const uint64_t key, std::vector<double> &features, uint32_t *extract_us) const
+{
+    const auto appended = this->appended_.find(key);
+    if (appended != this->appended_.end())
+    {
+        features = appended->second.features;
+        if (extract_us != nullptr)
+        {
+            *extract_us = appended->second.extract_us;
+        }
+        return true;
+    }
+    const auto entry = this->index_.find(key);
+    if (entry != this->index_.end())
+    {
+        features.assign(entry->second.features, entry->second.features + entry->second.num_features);
+        if (extract_us != nullptr)
+        {
+            *extract_us = entry->second.extract_us;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief appends a record to the cache file, written with a single write call
+ *
+ * @param[in] key cache key from make_key
+ * @param[in] features flattened features
+ * @param[in] extract_us microseconds the pipeline took for the features
+ * @return int 0 if no errors, 5 if the cache is not open or the write failed
+ */
+int FeatureCache::append(const uint64_t key, const std::vector<double> &features, const uint32_t extract_us)
+{
+    if (this->fd_ < 0)
+    {
+        return 5;
+    }
+    const RecordHeader header = {key, (uint32_t)features.size(), extract_us};
+    std::string record(sizeof(header) + features.size() * sizeof(double), '\0');
+    std::memcpy(&record[0], &header, sizeof(header));
+    if (features.size() > 0)
+    {
+        std::memcpy(&record[sizeof(header)], features.data(), features.size() * sizeof(double));
+    }
+
+    std::size_t written = 0;
+    while (written < record.size())
+    {
+        const ssize_t ret = write(this->fd_, record.data() + written, record.size() - written);
+        if (ret <= 0)
+        {
+            return 5;
+        }
+        written += ret;
+    }
+    this->appended_[key] = {features, extract_us};
+    return 0;
+}
+
+/**
+ * @brief returns the number of cached feature vectors
+ *
+ * @return std::size_t
+ */
+std::size_t FeatureCache::size(void) const
+{
+    std::size_t num_new = 0;
+    for (const auto &entry : this->appended_)
+    {
+        num_new += this->index_.count(entry.first) == 0 ? 1 : 0;
+    }
+    return this->index_.size() + num_new;
+}
+
+/**
+ * @brief returns the number of get_features calls answered by the cache
+ *
+ * @return std::size_t
+ */
+std::size_t FeatureCache::hits(void) const
+{
+    return this->hits_;
+}
+
+/**
+ * @brief returns the number of get_features calls that ran the pipeline
+ *
+ * @return std::size_t
+ */
+std::size_t FeatureCache::misses(void) const
+{
+    return this->misses_;
+}
+
+/**
+ * @brief returns the pipeline time the hits didn't spend, i.e. the time
+ *        stored with each record minus the time the hit took
+ *
+ * @return double seconds
+ */
+double FeatureCache::saved_seconds(void) const
+{
+    return this->saved_seconds_;
+}
+
+/**
+ * @brief creates the cache key from the bitmap bytes, the pipeline settings
+ *        and the kernel weights that init_kernel creates for them.
+ *
+ * @param[in] content the bytes of a bitmap file
+ * @param[in] config pipeline settings
+ * @return uint64_t
+ */
+uint64_t FeatureCache::make_key(const std::string &content, const ConvLayer::PipelineConfig &config)
+{
+    uint64_t hash = fnv1a(content.data(), content.size(), 14695981039346656037ULL);
+    const uint64_t settings[] = {config.zero_padding, config.kernel_size, config.stride,
+                                 (uint64_t)config.pooling_option, config.pooling_size, config.compact_storage};
+    hash = fnv1a(settings, sizeof(settings), hash);
+
+    ConvLayer kernel;
+    kernel.init_kernel(config.kernel_size);
+    for (const auto &row : kernel.get_kernel())
+    {
+        hash = fnv1a(row.data(), row.size() * sizeof(double), hash);
+    }
+    return hash;
+}
+
+/**
+ * @brief 64-bit FNV-1a hash
+ *
+ * @param[in] data bytes to hash
+ * @param[in] size number of bytes
+ * @param[in] hash hash of the previous data or the FNV offset basis
+ * @return uint64_t
+ */
+uint64_t FeatureCache::fnv1a(const void *data, const std::size_t size, uint64_t hash)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
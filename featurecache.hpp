@@ -0,0 +1,79 @@
+#ifndef FEATURECACHE_HPP_
+#define FEATURECACHE_HPP_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "convlayer.hpp"
+
+#define FEATURE_CACHE_MAGIC "FCACHE01"
+
+/**
+ * @brief Class for a persistent cache of flattened conv/pool features.
+ * @details the features of a bitmap only depend on the bytes of the file and
+ *          the pipeline settings (including the kernel weights), so they are
+ *          stored under a 64-bit FNV-1a hash of both.
+ *
+ *          File layout, every field is 8-byte aligned so the file can be
+ *          used directly through a read-only mmap:
+ *          [magic 8 bytes]
+ *          [key uint64][num_features uint32][extract_us uint32][features double * num_features]
+ *          ...
+ *          extract_us is the time the pipeline took for the record, so a hit
+ *          knows how much time it saved (0 in files written before it was kept).
+ *          Records are only ever appended. A record cut short by a crash is
+ *          ignored when the file is opened and overwritten by the next append.
+ */
+class FeatureCache
+{
+public:
+    FeatureCache(void) {}
+    FeatureCache(const char *filename);
+    ~FeatureCache();
+    FeatureCache(const FeatureCache &) = delete;
+    FeatureCache &operator=(const FeatureCache &) = delete;
+    int open(const char *filename);
+    void close(void);
+    int get_features(const char *bmp_filename, const ConvLayer::PipelineConfig &config,
+                     std::vector<double> &features);
+    bool lookup(const uint64_t key, std::vector<double> &features, uint32_t *extract_us = nullptr) const;
+    int append(const uint64_t key, const std::vector<double> &features, const uint32_t extract_us = 0);
+    std::size_t size(void) const;
+    std::size_t hits(void) const;
+    std::size_t misses(void) const;
+    double saved_seconds(void) const;
+    static uint64_t make_key(const std::string &content, const ConvLayer::PipelineConfig &config);
+
+private:
+    struct Entry
+    {
+        const double *features;
+        uint32_t num_features;
+        uint32_t extract_us;
+    };
+    struct Appended
+    {
+        std::vector<double> features;
+        uint32_t extract_us;
+    };
+    struct RecordHeader
+    {
+        uint64_t key;
+        uint32_t num_features;
+        uint32_t extract_us;
+    };
+
+    int fd_ = -1;
+    const char *map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::unordered_map<uint64_t, Entry> index_;
+    std::unordered_map<uint64_t, Appended> appended_;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+    double saved_seconds_ = 0.0;
+    static uint64_t fnv1a(const void *data, const std::size_t size, uint64_t hash);
+};
+
+#endif /* FEATURECACHE_HPP_ */
@@ -0,0 +1,60 @@
+#ifndef FEATUREMAP_HPP_
+#define FEATUREMAP_HPP_
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Class for a compact 2D image or feature map stored row by row in
+ *        one contiguous buffer.
+ * @details the element type is chosen to fit the values, uint8_t for grey
+ *          pixels and conv/pool output (which ConvLayer truncates to 8 bits
+ *          anyway) takes 1 byte per pixel instead of the 8 bytes of a double.
+ *          The kernels widen the values when they read them.
+ *
+ * @param[in] height number of rows
+ * @param[in] width number of pixels per row
+ * @param[in] value initial value of every pixel
+ */
+template <typename T>
+class FeatureMap
+{
+public:
+    FeatureMap(void) {}
+    FeatureMap(const std::size_t height, const std::size_t width, const T value = T())
+    {
+        this->resize(height, width, value);
+    }
+    ~FeatureMap() {}
+
+    /**
+     * @brief changes the size and sets every pixel to value
+     *
+     * @param[in] height number of rows
+     * @param[in] width number of pixels per row
+     * @param[in] value new value of every pixel
+     */
+    void resize(const std::size_t height, const std::size_t width, const T value = T())
+    {
+        this->height_ = height;
+        this->width_ = width;
+        this->data_.assign(height * width, value);
+    }
+
+    std::size_t height(void) const { return this->height_; }
+    std::size_t width(void) const { return this->width_; }
+    std::size_t size(void) const { return this->data_.size(); }
+    std::size_t bytes(void) const { return this->data_.size() * sizeof(T); }
+    T *row(const std::size_t y) { return &this->data_[y * this->width_]; }
+    const T *row(const std::size_t y) const { return &this->data_[y * this->width_]; }
+    T &operator()(const std::size_t y, const std::size_t x) { return this->data_[y * this->width_ + x]; }
+    const T &operator()(const std::size_t y, const std::size_t x) const { return this->data_[y * this->width_ + x]; }
+    const std::vector<T> &data(void) const { return this->data_; }
+
+private:
+    std::size_t height_ = 0;
+    std::size_t width_ = 0;
+    std::vector<T> data_;
+};
+
+#endif /* FEATUREMAP_HPP_ */
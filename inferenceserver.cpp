@@ -0,0 +1,727 @@
+#include "inferenceserver.hpp"
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_LATENCY_SAMPLES 1000000
+#define MAX_RAW_PIXELS (4096 * 4096)
+
+/**
+ * @brief buffered reader for lines and raw bytes from a file descriptor
+ */
+struct FdReader
+{
+    int fd;
+    std::string buffer;
+    std::size_t pos = 0;
+
+    bool fill(void)
+    {
+        if (pos > 0)
+        {
+            buffer.erase(0, pos);
+            pos = 0;
+        }
+        char chunk[4096];
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            return false;
+        }
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    bool read_line(std::string &line)
+    {
+        for (;;)
+        {
+            const std::size_t end = buffer.find('\n', pos);
+            if (end != std::string::npos)
+            {
+                line.assign(buffer, pos, end - pos);
+                pos = end + 1;
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+                return true;
+            }
+            if (!fill())
+            {
+                return false;
+            }
+        }
+    }
+
+    bool read_bytes(std::string &bytes, const std::size_t size)
+    {
+        while (buffer.size() - pos < size)
+        {
+            if (!fill())
+            {
+                return false;
+            }
+        }
+        bytes.assign(buffer, pos, size);
+        pos += size;
+        return true;
+    }
+};
+
+/**
+ * @brief returns a monotonic timestamp in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief returns a future that is already set to response
+ */
+static std::future<std::string> ready(const std::string &response)
+{
+    std::promise<std::string> promise;
+    promise.set_value(response);
+    return promise.get_future();
+}
+
+/**
+ * @brief Construct a new InferenceServer::InferenceServer object and starts the batch thread
+ *
+ * @param[in] network trained network, only used by the batch thread
+ * @param[in] config batching and pipeline settings
+ */
+InferenceServer::InferenceServer(NeuralNetwork &network, const Config &config)
+    : network_(network), config_(config), running_(true)
+{
+    if (this->config_.max_batch == 0)
+    {
+        this->config_.max_batch = 1;
+    }
+    this->batch_thread_ = std::thread(&InferenceServer::batch_loop, this);
+}
+
+/**
+ * @brief Destructor stops the server and waits for the batch thread
+ *
+ */
+InferenceServer::~InferenceServer()
+{
+    this->stop();
+    if (this->batch_thread_.joinable())
+    {
+        this->batch_thread_.join();
+    }
+}
+
+/**
+ * @brief listens on a Unix domain socket until stop() or a shutdown request.
+ *
+ * @param[in] socket_path path of the socket, an old socket file is replaced
+ * @return int 0 if no errors, 1 if the socket can't be created
+ */
+int InferenceServer::serve_socket(const char *socket_path)
+{
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->listen_fd_ = fd;
+    }
+
+    std::vector<std::thread> connections;
+    while (this->running_)
+    {
+        const int connection_fd = accept(fd, nullptr, nullptr);
+        this->reap_connections(connections);
+        if (connection_fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                // out of descriptors, wait for connections to finish instead of giving up
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->connection_fds_.push_back(connection_fd);
+        }
+        connections.emplace_back(&InferenceServer::serve_connection, this, connection_fd);
+    }
+    this->stop();
+    for (auto &connection : connections)
+    {
+        connection.join();
+    }
+    this->finished_connections_.clear();
+    close(fd);
+    unlink(socket_path);
+    return 0;
+}
+
+/**
+ * @brief runs handle_connection for an accepted socket, then closes it and
+ *        marks the thread as finished so serve_socket can join it
+ *
+ * @param[in] connection_fd accepted socket, owned by this call
+ */
+void InferenceServer::serve_connection(const int connection_fd)
+{
+    this->handle_connection(connection_fd, connection_fd);
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    // removed and closed under the mutex, so stop() never shuts down a reused descriptor
+    this->connection_fds_.erase(std::remove(this->connection_fds_.begin(), this->connection_fds_.end(), connection_fd),
+                                this->connection_fds_.end());
+    close(connection_fd);
+    this->finished_connections_.push_back(std::this_thread::get_id());
+}
+
+/**
+ * @brief joins the connection threads that have finished
+ *
+ * @param[in,out] connections threads of serve_socket, finished ones are removed
+ */
+void InferenceServer::reap_connections(std::vector<std::thread> &connections)
+{
+    std::vector<std::thread::id> finished;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        finished.swap(this->finished_connections_);
+    }
+    for (const auto id : finished)
+    {
+        for (std::size_t i = 0; i < connections.size(); i++)
+        {
+            if (connections[i].get_id() == id)
+            {
+                connections[i].join();
+                std::swap(connections[i], connections.back());
+                connections.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief serves requests from one stream, e.g. stdin/stdout, until end of input
+ *
+ * @param[in] in_fd file descriptor to read requests from
+ * @param[in] out_fd file descriptor to write responses to
+ * @return int 0
+ */
+int InferenceServer::serve_fd(const int in_fd, const int out_fd)
+{
+    this->handle_connection(in_fd, out_fd);
+    return 0;
+}
+
+/**
+ * @brief stops accepting requests, queued requests are still answered
+ *
+ */
+void InferenceServer::stop(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->running_ = false;
+    if (this->listen_fd_ >= 0)
+    {
+        shutdown(this->listen_fd_, SHUT_RDWR);
+        this->listen_fd_ = -1;
+    }
+    for (const auto connection_fd : this->connection_fds_)
+    {
+        shutdown(connection_fd, SHUT_RD);
+    }
+    this->queue_cv_.notify_all();
+}
+
+/**
+ * @brief returns latency percentiles and throughput of all answered requests
+ *
+ * @return Stats
+ */
+InferenceServer::Stats InferenceServer::get_stats(void)
+{
+    Stats stats;
+    std::vector<double> latencies_ms;
+    {
+        // one copy under the lock, the batch thread records latencies with it held
+        std::lock_guard<std::mutex> lock(this->stats_mutex_);
+        stats.num_requests = this->num_requests_;
+        stats.num_batches = this->num_batches_;
+        latencies_ms = this->latencies_ms_;
+        const double seconds = (this->last_response_ns_ - this->first_request_ns_) * 1e-9;
+        stats.requests_per_s = seconds > 0 ? this->num_requests_ / seconds : 0.0;
+    }
+    stats.mean_batch_size = stats.num_batches > 0 ? (double)stats.num_requests / stats.num_batches : 0.0;
+    std::sort(latencies_ms.begin(), latencies_ms.end());
+    stats.p50_ms = sorted_percentile(latencies_ms, 0.50);
+    stats.p95_ms = sorted_percentile(latencies_ms, 0.95);
+    stats.p99_ms = sorted_percentile(latencies_ms, 0.99);
+    stats.max_ms = sorted_percentile(latencies_ms, 1.0);
+    return stats;
+}
+
+/**
+ * @brief prints the stats as JSON
+ *
+ * @param[in] ostream chosen output stream
+ */
+void InferenceServer::print_stats(std::ostream &ostream)
+{
+    ostream << stats_json(this->get_stats()) << "\n";
+}
+
+/**
+ * @brief returns the p-quantile (0.0 - 1.0) of the values, nearest rank
+ *
+ * @param[in] values samples, taken by value since they are reordered
+ * @param[in] p quantile
+ * @return double 0.0 if there are no values
+ */
+double InferenceServer::percentile(std::vector<double> values, const double p)
+{
+    if (values.size() == 0)
+    {
+        return 0.0;
+    }
+    std::size_t rank = (std::size_t)(p * values.size() + 0.5);
+    rank = rank == 0 ? 0 : std::min(rank - 1, values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+/**
+ * @brief returns the p-quantile (0.0 - 1.0) of values sorted in ascending
+ *        order, nearest rank as percentile() but without copying
+ *
+ * @param[in] sorted samples in ascending order
+ * @param[in] p quantile
+ * @return double 0.0 if there are no values
+ */
+double InferenceServer::sorted_percentile(const std::vector<double> &sorted, const double p)
+{
+    if (sorted.size() == 0)
+    {
+        return 0.0;
+    }
+    std::size_t rank = (std::size_t)(p * sorted.size() + 0.5);
+    rank = rank == 0 ? 0 : std::min(rank - 1, sorted.size() - 1);
+    return sorted[rank];
+}
+
+/**
+ * @brief writes all data to a socket or file, without SIGPIPE if the peer is gone
+ *
+ * @param[in] fd file descriptor
+ * @param[in] data bytes to write
+ * @return true if everything was written
+ */
+bool InferenceServer::write_all(const int fd, const std::string &data)
+{
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && errno == ENOTSOCK)
+        {
+            n = write(fd, data.data() + written, data.size() - written);
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+/**
+ * @brief collects requests into batches and runs them through the network
+ *
+ */
+void InferenceServer::batch_loop(void)
+{
+    const uint64_t budget_ns = (uint64_t)(this->config_.latency_budget_ms * 1e6);
+    std::vector<std::unique_ptr<Request>> batch;
+    std::vector<double> features;
+    Tensor<uint8_t> images;
+    FeatureMap<double> batch_features;
+    FeatureMap<double> batch_outputs;
+    batch.reserve(this->config_.max_batch);
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    for (;;)
+    {
+        this->queue_cv_.wait(lock, [this]
+                             { return !this->queue_.empty() || !this->running_; });
+        if (this->queue_.empty())
+        {
+            break;
+        }
+        const auto deadline = std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(this->queue_.front()->enqueue_ns + budget_ns));
+        this->queue_cv_.wait_until(lock, deadline, [this]
+                                   { return this->queue_.size() >= this->config_.max_batch || !this->running_; });
+
+        while (!this->queue_.empty() && batch.size() < this->config_.max_batch)
+        {
+            batch.push_back(std::move(this->queue_.front()));
+            this->queue_.pop_front();
+        }
+        lock.unlock();
+
+        PROFILE_SCOPE("inference_batch", -1, 0, 0);
+        this->process_raw(batch, images, batch_features, batch_outputs);
+        for (auto &request : batch)
+        {
+            if (request->bmp)
+            {
+                this->process(*request, features);
+            }
+        }
+        const uint64_t done_ns = now_ns();
+        {
+            std::lock_guard<std::mutex> stats_lock(this->stats_mutex_);
+            for (const auto &request : batch)
+            {
+                if (this->first_request_ns_ == 0 || request->enqueue_ns < this->first_request_ns_)
+                {
+                    this->first_request_ns_ = request->enqueue_ns;
+                }
+                const double latency_ms = (done_ns - request->enqueue_ns) * 1e-6;
+                if (this->latencies_ms_.size() < MAX_LATENCY_SAMPLES)
+                {
+                    this->latencies_ms_.push_back(latency_ms);
+                }
+                else
+                {
+                    this->latencies_ms_[this->num_requests_ % MAX_LATENCY_SAMPLES] = latency_ms;
+                }
+                this->num_requests_++;
+            }
+            this->num_batches_++;
+            this->last_response_ns_ = done_ns;
+        }
+        for (auto &request : batch)
+        {
+            request->response.set_value(request->result);
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+/**
+ * @brief runs one request through conv -> pool -> predict and stores the response line
+ *
+ * @param[in] request request to answer
+ * @param[out] features scratch buffer for the flattened features
+ */
+void InferenceServer::process(Request &request, std::vector<double> &features)
+{
+    if (request.bmp)
+    {
+        std::string content;
+        int ret = ConvLayer::read_file(request.path.c_str(), content);
+        if (ret == 0)
+        {
+            ret = ConvLayer::extract_features(content, this->config_.pipeline, features);
+        }
+        if (ret != 0)
+        {
+            request.result = "error " + std::to_string(ret) + " import error\n";
+            return;
+        }
+    }
+    else
+    {
+        ConvLayer::extract_features(request.image, this->config_.pipeline, features);
+    }
+
+    if (!this->check_num_features(request, features.size()))
+    {
+        return;
+    }
+    const std::vector<double> &outputs = this->network_.predict(features);
+    request.result = ok_response(outputs.data(), outputs.size());
+}
+
+/**
+ * @brief answers the raw requests of a batch with one batched conv -> pool ->
+ *        predict per image shape, the images are copied into one NCHW tensor.
+ *
+ * @param[in] batch requests of the batch, bmp requests are skipped
+ * @param[out] images scratch tensor for the images of one shape
+ * @param[out] features scratch matrix for the features, one row per image
+ * @param[out] outputs scratch matrix for the predictions, one row per image
+ */
+void InferenceServer::process_raw(std::vector<std::unique_ptr<Request>> &batch, Tensor<uint8_t> &images,
+                                  FeatureMap<double> &features, FeatureMap<double> &outputs)
+{
+    std::vector<Request *> group;
+    for (std::size_t first = 0; first < batch.size(); first++)
+    {
+        const Request &shape = *batch[first];
+        if (shape.bmp || !shape.result.empty())
+        {
+            continue;
+        }
+        group.clear();
+        for (std::size_t i = first; i < batch.size(); i++)
+        {
+            if (!batch[i]->bmp && batch[i]->result.empty() && batch[i]->image.height() == shape.image.height() &&
+                batch[i]->image.width() == shape.image.width())
+            {
+                group.push_back(batch[i].get());
+            }
+        }
+
+        images.resize(group.size(), 1, shape.image.height(), shape.image.width());
+        for (std::size_t n = 0; n < group.size(); n++)
+        {
+            std::copy(group[n]->image.data().begin(), group[n]->image.data().end(), images.plane(n, 0));
+        }
+        ConvLayer::extract_features(images, this->config_.pipeline, features);
+        if (!this->check_num_features(*group[0], features.width()))
+        {
+            for (auto request : group)
+            {
+                request->result = group[0]->result;
+            }
+            continue;
+        }
+        this->network_.predict_batch(features, outputs);
+        for (std::size_t n = 0; n < group.size(); n++)
+        {
+            group[n]->result = ok_response(outputs.row(n), outputs.width());
+        }
+    }
+}
+
+/**
+ * @brief sets an error result if the number of features doesn't match the network
+ *
+ * @param[in] request request to answer
+ * @param[in] num_features number of features of the request's image
+ * @return true if the network accepts the features
+ */
+bool InferenceServer::check_num_features(Request &request, const std::size_t num_features)
+{
+    if (num_features != this->network_.get_hidden_layers()[0].num_weights())
+    {
+        request.result = "error 7 image gives " + std::to_string(num_features) +
+                         " features, the network expects " +
+                         std::to_string(this->network_.get_hidden_layers()[0].num_weights()) + "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief creates the response line of a prediction
+ *
+ * @param[in] outputs network outputs
+ * @param[in] num_outputs number of outputs
+ * @return std::string "ok <outputs>\n"
+ */
+std::string InferenceServer::ok_response(const double *outputs, const std::size_t num_outputs)
+{
+    std::ostringstream response;
+    response << "ok";
+    for (std::size_t i = 0; i < num_outputs; i++)
+    {
+        response << " " << outputs[i];
+    }
+    response << "\n";
+    return response.str();
+}
+
+/**
+ * @brief reads requests from a connection and writes the responses in order.
+ *
+ * @details a writer thread waits for the responses, so the reader can keep
+ *          queueing requests that the client sent without waiting.
+ * @param[in] in_fd file descriptor to read requests from
+ * @param[in] out_fd file descriptor to write responses to
+ */
+void InferenceServer::handle_connection(const int in_fd, const int out_fd)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::future<std::string>> pending;
+    bool done = false;
+
+    auto write_responses = [&]()
+    {
+        bool ok = true;
+        for (;;)
+        {
+            std::future<std::string> response;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return !pending.empty() || done; });
+                if (pending.empty())
+                {
+                    break;
+                }
+                response = std::move(pending.front());
+                pending.pop_front();
+            }
+            const std::string line = response.get();
+            ok = ok && write_all(out_fd, line);
+        }
+    };
+    std::thread writer(write_responses);
+
+    auto push = [&](std::future<std::string> response)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(response));
+        cv.notify_one();
+    };
+
+    FdReader reader = {in_fd, std::string(), 0};
+    std::string line;
+    while (this->running_ && reader.read_line(line))
+    {
+        std::istringstream command(line);
+        std::string kind;
+        command >> kind;
+        if (kind.empty())
+        {
+            continue;
+        }
+        if (kind == "bmp")
+        {
+            auto request = std::make_unique<Request>();
+            std::getline(command >> std::ws, request->path);
+            push(this->submit(std::move(request)));
+        }
+        else if (kind == "raw")
+        {
+            std::size_t width = 0;
+            std::size_t height = 0;
+            command >> width >> height;
+            std::string pixels;
+            if (!command || width == 0 || height == 0 || width * height > MAX_RAW_PIXELS)
+            {
+                push(ready("error 8 bad raw header\n"));
+                break;
+            }
+            if (!reader.read_bytes(pixels, width * height))
+            {
+                break;
+            }
+            auto request = std::make_unique<Request>();
+            request->bmp = false;
+            request->image.resize(height, width);
+            for (std::size_t y = 0; y < height; y++)
+            {
+                std::copy(pixels.begin() + y * width, pixels.begin() + (y + 1) * width, request->image.row(y));
+            }
+            push(this->submit(std::move(request)));
+        }
+        else if (kind == "stats")
+        {
+            push(ready(stats_json(this->get_stats()) + "\n"));
+        }
+        else if (kind == "shutdown")
+        {
+            push(ready("ok\n"));
+            this->stop();
+            break;
+        }
+        else
+        {
+            push(ready("error 9 unknown request " + kind + "\n"));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_one();
+    }
+    writer.join();
+}
+
+/**
+ * @brief puts a request in the batch queue
+ *
+ * @param[in] request request to queue
+ * @return std::future<std::string> the response line
+ */
+std::future<std::string> InferenceServer::submit(std::unique_ptr<Request> request)
+{
+    std::future<std::string> response = request->response.get_future();
+    request->enqueue_ns = now_ns();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        if (!this->running_)
+        {
+            return ready("error 10 server is stopping\n");
+        }
+        this->queue_.push_back(std::move(request));
+    }
+    this->queue_cv_.notify_all();
+    return response;
+}
+
+/**
+ * @brief formats the stats as a one line JSON object
+ *
+ * @param[in] stats stats from get_stats
+ * @return std::string
+ */
+std::string InferenceServer::stats_json(const Stats &stats)
+{
+    std::ostringstream json;
+    json << "{\"requests\": " << stats.num_requests
+         << ", \"batches\": " << stats.num_batches
+         << ", \"mean_batch_size\": " << stats.mean_batch_size
+         << ", \"p50_ms\": " << stats.p50_ms
+         << ", \"p95_ms\": " << stats.p95_ms
+         << ", \"p99_ms\": " << stats.p99_ms
+         << ", \"max_ms\": " << stats.max_ms
+         << ", \"requests_per_s\": " << stats.requests_per_s << "}";
+    return json.str();
+}
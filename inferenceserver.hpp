@@ -0,0 +1,108 @@
+#ifndef INFERENCESERVER_HPP_
+#define INFERENCESERVER_HPP_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+
+#include "neuralnetwork.hpp"
+#include "convlayer.hpp"
+
+/**
+ * @brief Class for serving predictions from a trained network.
+ * @details requests arrive as lines on stdin or on a Unix domain socket:
+ *          bmp <path>                 bitmap file on the server
+ *          raw <width> <height>       followed by width * height bytes of grey pixels
+ *          stats                      latency and throughput as JSON
+ *          shutdown                   stops the server
+ *          Every request gets one line back, "ok <output 0> <output 1> ..."
+ *          or "error <code> <message>".
+ *
+ *          Requests from all connections are put in one queue. A batch
+ *          thread waits until max_batch requests are queued or the oldest
+ *          has waited latency_budget_ms, then runs the whole batch through
+ *          conv -> pool -> predict. Responses on a connection are written
+ *          in request order, so a client can pipeline requests.
+ */
+class InferenceServer
+{
+public:
+    struct Config
+    {
+        std::size_t max_batch = 16;
+        double latency_budget_ms = 2.0;
+        ConvLayer::PipelineConfig pipeline;
+    };
+
+    struct Stats
+    {
+        std::size_t num_requests = 0;
+        std::size_t num_batches = 0;
+        double mean_batch_size = 0.0;
+        double p50_ms = 0.0;
+        double p95_ms = 0.0;
+        double p99_ms = 0.0;
+        double max_ms = 0.0;
+        double requests_per_s = 0.0;
+    };
+
+    InferenceServer(NeuralNetwork &network, const Config &config);
+    ~InferenceServer();
+    int serve_socket(const char *socket_path);
+    int serve_fd(const int in_fd, const int out_fd);
+    void stop(void);
+    Stats get_stats(void);
+    void print_stats(std::ostream &ostream = std::cout);
+    static double percentile(std::vector<double> values, const double p);
+    static double sorted_percentile(const std::vector<double> &sorted, const double p);
+    static bool write_all(const int fd, const std::string &data);
+
+private:
+    struct Request
+    {
+        bool bmp = true;
+        std::string path;
+        FeatureMap<uint8_t> image;
+        uint64_t enqueue_ns = 0;
+        std::string result;
+        std::promise<std::string> response;
+    };
+
+    NeuralNetwork &network_;
+    Config config_;
+    std::atomic<bool> running_;
+    int listen_fd_ = -1;
+    std::thread batch_thread_;
+    std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<std::unique_ptr<Request>> queue_;
+    std::vector<int> connection_fds_;
+    std::vector<std::thread::id> finished_connections_;
+    std::mutex stats_mutex_;
+    std::vector<double> latencies_ms_;
+    std::size_t num_requests_ = 0;
+    std::size_t num_batches_ = 0;
+    uint64_t first_request_ns_ = 0;
+    uint64_t last_response_ns_ = 0;
+
+    void batch_loop(void);
+    void process(Request &request, std::vector<double> &features);
+    void process_raw(std::vector<std::unique_ptr<Request>> &batch, Tensor<uint8_t> &images,
+                     FeatureMap<double> &features, FeatureMap<double> &outputs);
+    bool check_num_features(Request &request, const std::size_t num_features);
+    static std::string ok_response(const double *outputs, const std::size_t num_outputs);
+    void handle_connection(const int in_fd, const int out_fd);
+    void serve_connection(const int connection_fd);
+    void reap_connections(std::vector<std::thread> &connections);
+    std::future<std::string> submit(std::unique_ptr<Request> request);
+    static std::string stats_json(const Stats &stats);
+};
+
+#endif /* INFERENCESERVER_HPP_ */
@@ -0,0 +1,428 @@
+#include "kernels.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <immintrin.h>
+
+// scalar versions, also used for the remainder of the vector versions
+
+static double dot_scalar(const double *a, const double *b, const std::size_t n, double sum)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void axpy_scalar(double *y, const double a, const double *x, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        y[i] += a * x[i];
+    }
+}
+
+static double sum_scalar(const double *values, const std::size_t n, double sum)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        sum += values[i];
+    }
+    return sum;
+}
+
+static double max_scalar(const double *values, const std::size_t n, double max)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        max = max < values[i] ? values[i] : max;
+    }
+    return max;
+}
+
+static void tanh_scalar(double *values, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        values[i] = tanh(values[i]);
+    }
+}
+
+static void relu_scalar(double *values, const std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        values[i] = values[i] > 0.0 ? values[i] : 0.0;
+    }
+}
+
+// SSE4.2, 2 doubles per register
+
+__attribute__((target("sse4.2"))) static double dot_sse42(const double *a, const double *b, const std::size_t n,
+                                                            double sum)
+{
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return dot_scalar(a + i, b + i, n - i, sum + lanes[0] + lanes[1]);
+}
+
+__attribute__((target("sse4.2"))) static void axpy_sse42(double *y, const double a, const double *x,
+                                                           const std::size_t n)
+{
+    const __m128d factor = _mm_set1_pd(a);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(factor, _mm_loadu_pd(x + i))));
+    }
+    axpy_scalar(y + i, a, x + i, n - i);
+}
+
+__attribute__((target("sse4.2"))) static double sum_sse42(const double *values, const std::size_t n, double sum)
+{
+    __m128d acc = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_add_pd(acc, _mm_loadu_pd(values + i));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return sum_scalar(values + i, n - i, sum + lanes[0] + lanes[1]);
+}
+
+__attribute__((target("sse4.2"))) static double max_sse42(const double *values, const std::size_t n, double max)
+{
+    __m128d acc = _mm_set1_pd(max);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        acc = _mm_max_pd(_mm_loadu_pd(values + i), acc);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return max_scalar(values + i, n - i, max_scalar(lanes, 2, max));
+}
+
+__attribute__((target("sse4.2"))) static void relu_sse42(double *values, const std::size_t n)
+{
+    const __m128d zero = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(values + i, _mm_max_pd(_mm_loadu_pd(values + i), zero));
+    }
+    relu_scalar(values + i, n - i);
+}
+
+// AVX2, 4 doubles per register
+
+__attribute__((target("avx2"))) static double dot_avx2(const double *a, const double *b, const std::size_t n,
+                                                         double sum)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return dot_scalar(a + i, b + i, n - i, sum + (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+__attribute__((target("avx2"))) static void axpy_avx2(double *y, const double a, const double *x,
+                                                        const std::size_t n)
+{
+    const __m256d factor = _mm256_set1_pd(a);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(factor, _mm256_loadu_pd(x + i))));
+    }
+    axpy_scalar(y + i, a, x + i, n - i);
+}
+
+__attribute__((target("avx2"))) static double sum_avx2(const double *values, const std::size_t n, double sum)
+{
+    __m256d acc = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_add_pd(acc, _mm256_loadu_pd(values + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return sum_scalar(values + i, n - i, sum + (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+}
+
+__attribute__((target("avx2"))) static double max_avx2(const double *values, const std::size_t n, double max)
+{
+    __m256d acc = _mm256_set1_pd(max);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = _mm256_max_pd(_mm256_loadu_pd(values + i), acc);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return max_scalar(values + i, n - i, max_scalar(lanes, 4, max));
+}
+
+__attribute__((target("avx2"))) static void relu_avx2(double *values, const std::size_t n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        _mm256_storeu_pd(values + i, _mm256_max_pd(_mm256_loadu_pd(values + i), zero));
+    }
+    relu_scalar(values + i, n - i);
+}
+
+// AVX-512, 8 doubles per register. max uses the all-lanes mask form, as the
+// plain _mm512_max_pd of gcc 12 warns about an uninitialized register at -O2
+
+__attribute__((target("avx512f"))) static double dot_avx512(const double *a, const double *b, const std::size_t n,
+                                                              double sum)
+{
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+        acc1 = _mm512_add_pd(acc1, _mm512_mul_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8)));
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm512_add_pd(acc0, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, _mm512_add_pd(acc0, acc1));
+    return dot_scalar(a + i, b + i, n - i, sum + sum_scalar(lanes, 8, 0.0));
+}
+
+__attribute__((target("avx512f"))) static void axpy_avx512(double *y, const double a, const double *x,
+                                                             const std::size_t n)
+{
+    const __m512d factor = _mm512_set1_pd(a);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_mul_pd(factor, _mm512_loadu_pd(x + i))));
+    }
+    axpy_scalar(y + i, a, x + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static double sum_avx512(const double *values, const std::size_t n, double sum)
+{
+    __m512d acc = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc = _mm512_add_pd(acc, _mm512_loadu_pd(values + i));
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+    return sum_scalar(values + i, n - i, sum + sum_scalar(lanes, 8, 0.0));
+}
+
+__attribute__((target("avx512f"))) static double max_avx512(const double *values, const std::size_t n, double max)
+{
+    __m512d acc = _mm512_set1_pd(max);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc = _mm512_maskz_max_pd(0xff, _mm512_loadu_pd(values + i), acc);
+    }
+    double lanes[8];
+    _mm512_storeu_pd(lanes, acc);
+    return max_scalar(values + i, n - i, max_scalar(lanes, 8, max));
+}
+
+__attribute__((target("avx512f"))) static void relu_avx512(double *values, const std::size_t n)
+{
+    const __m512d zero = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm512_storeu_pd(values + i, _mm512_maskz_max_pd(0xff, _mm512_loadu_pd(values + i), zero));
+    }
+    relu_scalar(values + i, n - i);
+}
+
+/**
+ * @brief returns the kernels, selected on the first call
+ *
+ * @return Kernels&
+ */
+Kernels &Kernels::instance(void)
+{
+    static Kernels kernels;
+    return kernels;
+}
+
+/**
+ * @brief selects the fastest supported set, or the one named by NN_ISA
+ */
+Kernels::Kernels(void)
+{
+    isa_option isa = detect();
+    const char *forced = std::getenv("NN_ISA");
+    if (forced != nullptr && forced[0] != '\0')
+    {
+        isa_option requested = isa_option::SCALAR;
+        if (parse_isa(forced, requested) != 0)
+        {
+            std::cerr << "NN_ISA=" << forced << " is unknown (scalar, sse4.2, avx2, avx512), using "
+                      << isa_name(isa) << std::endl;
+        }
+        else if (!supported(requested))
+        {
+            std::cerr << "NN_ISA=" << forced << " is not supported by this CPU, using " << isa_name(isa) << std::endl;
+        }
+        else
+        {
+            isa = requested;
+        }
+    }
+    this->select(isa);
+}
+
+/**
+ * @brief switches to the kernels of another instruction set. Not thread safe,
+ *        only call it while no other thread uses the kernels.
+ *
+ * @param[in] isa instruction set
+ * @return int 0 if no errors, 1 if the CPU doesn't support it (nothing changes)
+ */
+int Kernels::select(const isa_option isa)
+{
+    if (!supported(isa))
+    {
+        return 1;
+    }
+    this->isa_ = isa;
+    this->tanh_ = tanh_scalar;
+    if (isa == isa_option::AVX512)
+    {
+        this->dot_ = dot_avx512;
+        this->axpy_ = axpy_avx512;
+        this->sum_ = sum_avx512;
+        this->max_ = max_avx512;
+        this->relu_ = relu_avx512;
+    }
+    else if (isa == isa_option::AVX2)
+    {
+        this->dot_ = dot_avx2;
+        this->axpy_ = axpy_avx2;
+        this->sum_ = sum_avx2;
+        this->max_ = max_avx2;
+        this->relu_ = relu_avx2;
+    }
+    else if (isa == isa_option::SSE42)
+    {
+        this->dot_ = dot_sse42;
+        this->axpy_ = axpy_sse42;
+        this->sum_ = sum_sse42;
+        this->max_ = max_sse42;
+        this->relu_ = relu_sse42;
+    }
+    else
+    {
+        this->dot_ = dot_scalar;
+        this->axpy_ = axpy_scalar;
+        this->sum_ = sum_scalar;
+        this->max_ = max_scalar;
+        this->relu_ = relu_scalar;
+    }
+    return 0;
+}
+
+/**
+ * @brief returns the fastest instruction set of the CPU (CPUID)
+ *
+ * @return isa_option
+ */
+isa_option Kernels::detect(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return isa_option::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return isa_option::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return isa_option::SSE42;
+    }
+    return isa_option::SCALAR;
+}
+
+/**
+ * @brief returns true if the CPU can run the instruction set
+ *
+ * @param[in] isa instruction set
+ * @return bool
+ */
+bool Kernels::supported(const isa_option isa)
+{
+    return (int)isa <= (int)detect();
+}
+
+/**
+ * @brief returns the name used by NN_ISA
+ *
+ * @param[in] isa instruction set
+ * @return const char*
+ */
+const char *Kernels::isa_name(const isa_option isa)
+{
+    switch (isa)
+    {
+    case isa_option::AVX512:
+        return "avx512";
+    case isa_option::AVX2:
+        return "avx2";
+    case isa_option::SSE42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief parses the name of an instruction set
+ *
+ * @param[in] name scalar, sse4.2, avx2 or avx512
+ * @param[out] isa instruction set
+ * @return int 0 if no errors, 1 if the name is unknown
+ */
+int Kernels::parse_isa(const char *name, isa_option &isa)
+{
+    for (const isa_option option : {isa_option::SCALAR, isa_option::SSE42, isa_option::AVX2, isa_option::AVX512})
+    {
+        if (std::strcmp(name, isa_name(option)) == 0)
+        {
+            isa = option;
+            return 0;
+        }
+    }
+    return 1;
+}
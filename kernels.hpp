@@ -0,0 +1,105 @@
+#ifndef KERNELS_HPP_
+#define KERNELS_HPP_
+
+#include <cstddef>
+
+/**
+ * @brief instruction sets the kernels are compiled for, from slowest to fastest
+ */
+enum class isa_option
+{
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+/**
+ * @brief Class for the hot loops of DenseLayer and ConvLayer, compiled once per
+ *        instruction set and selected at startup.
+ * @details every kernel exists as a scalar loop and as SSE4.2 (2 doubles),
+ *          AVX2 (4 doubles) and AVX-512 (8 doubles) versions, built with
+ *          function target attributes so one binary runs on any x86-64 host.
+ *          tanh is the exception: it calls the C library for every value with
+ *          each set, as there is no vector tanh to call.
+ *          The first call of instance() selects the fastest set the CPU
+ *          supports (CPUID). The environment variable NN_ISA (scalar, sse4.2,
+ *          avx2 or avx512) forces a set, e.g. to benchmark or verify each one
+ *          on a single machine; a set the CPU doesn't support is ignored.
+ *
+ *          axpy, max and the activations give the same bits with every set.
+ *          dot and sum add in several lanes, so their results may differ in
+ *          the last bits from the scalar loop, which adds in index order.
+ */
+class Kernels
+{
+public:
+    static Kernels &instance(void);
+    int select(const isa_option isa);
+    isa_option isa(void) const { return this->isa_; }
+    static isa_option detect(void);
+    static bool supported(const isa_option isa);
+    static const char *isa_name(const isa_option isa);
+    static int parse_isa(const char *name, isa_option &isa);
+
+    /**
+     * @brief returns sum + a[0] * b[0] + ... + a[n - 1] * b[n - 1]
+     */
+    double dot(const double *a, const double *b, const std::size_t n, const double sum) const
+    {
+        return this->dot_(a, b, n, sum);
+    }
+
+    /**
+     * @brief y[i] += a * x[i] for i < n
+     */
+    void axpy(double *y, const double a, const double *x, const std::size_t n) const
+    {
+        this->axpy_(y, a, x, n);
+    }
+
+    /**
+     * @brief returns sum + values[0] + ... + values[n - 1]
+     */
+    double sum(const double *values, const std::size_t n, const double sum) const
+    {
+        return this->sum_(values, n, sum);
+    }
+
+    /**
+     * @brief returns the largest of max and values[0 .. n - 1]
+     */
+    double max(const double *values, const std::size_t n, const double max) const
+    {
+        return this->max_(values, n, max);
+    }
+
+    /**
+     * @brief values[i] = tanh(values[i]) for i < n
+     */
+    void apply_tanh(double *values, const std::size_t n) const
+    {
+        this->tanh_(values, n);
+    }
+
+    /**
+     * @brief values[i] = values[i] > 0 ? values[i] : 0 for i < n
+     */
+    void apply_relu(double *values, const std::size_t n) const
+    {
+        this->relu_(values, n);
+    }
+
+private:
+    isa_option isa_ = isa_option::SCALAR;
+    double (*dot_)(const double *, const double *, const std::size_t, double) = nullptr;
+    void (*axpy_)(double *, const double, const double *, const std::size_t) = nullptr;
+    double (*sum_)(const double *, const std::size_t, double) = nullptr;
+    double (*max_)(const double *, const std::size_t, double) = nullptr;
+    void (*tanh_)(double *, const std::size_t) = nullptr;
+    void (*relu_)(double *, const std::size_t) = nullptr;
+
+    Kernels(void);
+};
+
+#endif /* KERNELS_HPP_ */
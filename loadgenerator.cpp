@@ -0,0 +1,166 @@
+#include "loadgenerator.hpp"
+#include "inferenceserver.hpp"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @brief sends the requests and prints the results
+ *
+ * @param[in] socket_path path of the server socket
+ * @param[in] bmp_path bitmap path sent in every request (as seen by the server)
+ * @param[in] num_requests total number of requests
+ * @param[in] num_connections number of concurrent connections
+ * @param[in] pipeline_depth max requests in flight per connection
+ * @param[in] ostream chosen output stream
+ * @return int 0 if no errors, 1 if the server can't be reached, 2 if a request failed
+ */
+int LoadGenerator::run(const char *socket_path,
+                       const char *bmp_path,
+                       const std::size_t num_requests,
+                       const std::size_t num_connections,
+                       const std::size_t pipeline_depth,
+                       std::ostream &ostream)
+{
+    const std::size_t connections = num_connections == 0 ? 1 : num_connections;
+    const std::size_t depth = pipeline_depth == 0 ? 1 : pipeline_depth;
+    const std::string request = std::string("bmp ") + bmp_path + "\n";
+    std::vector<std::vector<double>> latencies_ms(connections);
+    std::vector<int> errors(connections, 0);
+    std::vector<std::thread> threads;
+
+    auto client = [&](const std::size_t c, const std::size_t share)
+    {
+        const int fd = connect_to(socket_path);
+        if (fd < 0)
+        {
+            errors[c] = 1;
+            return;
+        }
+        std::deque<std::chrono::steady_clock::time_point> sent;
+        std::string buffer;
+        std::size_t num_sent = 0;
+        std::size_t num_received = 0;
+        while (num_received < share)
+        {
+            while (num_sent < share && sent.size() < depth)
+            {
+                sent.push_back(std::chrono::steady_clock::now());
+                if (!InferenceServer::write_all(fd, request))
+                {
+                    errors[c] = 1;
+                    close(fd);
+                    return;
+                }
+                num_sent++;
+            }
+            std::size_t end;
+            while ((end = buffer.find('\n')) == std::string::npos)
+            {
+                char chunk[4096];
+                const ssize_t n = read(fd, chunk, sizeof(chunk));
+                if (n <= 0)
+                {
+                    errors[c] = 1;
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, n);
+            }
+            if (buffer.compare(0, 2, "ok") != 0)
+            {
+                errors[c] = 2;
+            }
+            buffer.erase(0, end + 1);
+            const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - sent.front();
+            sent.pop_front();
+            latencies_ms[c].push_back(latency.count());
+            num_received++;
+        }
+        close(fd);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t c = 0; c < connections; c++)
+    {
+        const std::size_t share = num_requests / connections + (c < num_requests % connections ? 1 : 0);
+        threads.emplace_back(client, c, share);
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    int ret = 0;
+    for (std::size_t c = 0; c < connections; c++)
+    {
+        all.insert(all.end(), latencies_ms[c].begin(), latencies_ms[c].end());
+        ret = std::max(ret, errors[c]);
+    }
+
+    ostream << "-=( load generator )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    ostream << "requests: " << all.size() << " of " << num_requests
+            << ", connections: " << connections << ", pipeline depth: " << depth << "\n";
+    ostream << "client latency ms  p50: " << InferenceServer::percentile(all, 0.50)
+            << "  p95: " << InferenceServer::percentile(all, 0.95)
+            << "  p99: " << InferenceServer::percentile(all, 0.99)
+            << "  max: " << InferenceServer::percentile(all, 1.0) << "\n";
+    ostream << "throughput: " << (elapsed.count() > 0 ? all.size() / elapsed.count() : 0.0) << " requests/s\n";
+
+    const int fd = connect_to(socket_path);
+    if (fd >= 0)
+    {
+        std::string stats;
+        char chunk[4096];
+        ssize_t n;
+        InferenceServer::write_all(fd, "stats\n");
+        while (stats.find('\n') == std::string::npos && (n = read(fd, chunk, sizeof(chunk))) > 0)
+        {
+            stats.append(chunk, n);
+        }
+        ostream << "server: " << stats;
+        close(fd);
+    }
+    else
+    {
+        ret = 1;
+    }
+    ostream << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return ret;
+}
+
+/**
+ * @brief connects to a Unix domain socket
+ *
+ * @param[in] socket_path path of the socket
+ * @return int file descriptor, -1 on error
+ */
+int LoadGenerator::connect_to(const char *socket_path)
+{
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    std::strcpy(address.sun_path, socket_path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,30 @@
+#ifndef LOADGENERATOR_HPP_
+#define LOADGENERATOR_HPP_
+
+#include <iostream>
+#include <string>
+
+/**
+ * @brief Class for testing an InferenceServer on a local Unix domain socket.
+ * @details opens num_connections connections that each send their share of
+ *          num_requests "bmp <path>" requests, keeping up to pipeline_depth
+ *          requests in flight per connection. Prints client side latency
+ *          percentiles and throughput followed by the stats of the server.
+ */
+class LoadGenerator
+{
+public:
+    LoadGenerator(void) {}
+    ~LoadGenerator() {}
+    int run(const char *socket_path,
+            const char *bmp_path,
+            const std::size_t num_requests = 1000,
+            const std::size_t num_connections = 4,
+            const std::size_t pipeline_depth = 1,
+            std::ostream &ostream = std::cout);
+
+private:
+    static int connect_to(const char *socket_path);
+};
+
+#endif /* LOADGENERATOR_HPP_ */
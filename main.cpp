@@ -1,6 +1,13 @@
 #include "main.hpp"
 
-int main(void)
+/**
+ * @brief runs the demo: imports a bitmap, shows each conv-layer step and
+ *        trains a neural network on the result.
+ *
+ * @param[in] model_path if not nullptr the trained network is saved here
+ * @return int 0 if no errors
+ */
+static int run_demo(const char *model_path)
 {
     char filename[] = "bitmaps/4_bw.bmp";
     ConvLayer image;
@@ -32,8 +39,22 @@ int main(void)
     std::cout << "after average pooling 2x2:" << std::endl;
     pooling2.print(ConvLayer::PrintOption::OUTPUT);
 
-    std::vector<std::vector<double>> train_x_in ;
-    train_x_in.push_back(pooling1.get_flatend_output());
+    // the training input comes from the feature cache, on a hit the bitmap
+    // is only hashed and extract_features is skipped
+    std::vector<std::vector<double>> train_x_in(1);
+    FeatureCache cache("features.cache");
+    const uint64_t start_ns = Profiler::now_ns();
+    s8ret = cache.get_features(filename, ConvLayer::PipelineConfig(), train_x_in[0]);
+    const double cache_us = (Profiler::now_ns() - start_ns) * 1e-3;
+    if (s8ret != 0)
+    {
+        std::cout << "feature cache error: " << s8ret << ", using the pooling output" << std::endl;
+        train_x_in[0] = pooling1.get_flatend_output();
+    }
+    std::cout << "feature cache: " << cache.size() << " entries, " << cache.hits() << " hit(s), "
+              << cache.misses() << " miss(es), features in " << cache_us << " us, saved "
+              << cache.saved_seconds() * 1e6 << " us" << std::endl
+              << std::endl;
     std::vector<std::vector<double>> train_yref_out = {{0,1,0,0}};
 
     NeuralNetwork nnOne(7*7, 0, 0, 4, activation_option::TANH);
@@ -44,12 +65,877 @@ int main(void)
     nnOne.train(200, 0.03);
     std::cout << "results afer 200 epochs and a learning rate of 0.03 :" << std::endl;
     nnOne.print_result();
+    nnOne.evaluate().print();
+    std::cout << std::endl;
+    SparseNetwork::print_pruning_report(nnOne, train_x_in);
+    std::cout << "-=( memory )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    MemoryTracker::print_usage(nnOne.memory_usage());
+    std::cout << "\nconv pipeline for a 15x15 bitmap:\n";
+    MemoryTracker::print_usage(ConvLayer::estimate_memory(15, 15, ConvLayer::PipelineConfig()));
+    if (MemoryTracker::enabled())
+    {
+        std::cout << "\n";
+        MemoryTracker::print_scopes();
+    }
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
     //nnOne.print_network(print_option::FULL);
+#ifdef ENABLE_PROFILING
+    {
+        std::ofstream profile_file("profile.json");
+        Profiler::instance().print_json(profile_file);
+        std::ofstream trace_file("trace.json");
+        Profiler::instance().print_chrome_trace(trace_file);
+        std::cout << "profile written to profile.json and trace.json" << std::endl;
+    }
+#endif
     
-    while (1)
+    if (model_path != nullptr)
+    {
+        if (nnOne.save(model_path) != 0)
+        {
+            std::cout << "could not save the model to " << model_path << std::endl;
+            return 1;
+        }
+        std::cout << "model saved to " << model_path << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief loads a saved model and answers requests until shutdown
+ *
+ * @param[in] model_path model saved with --save-model
+ * @param[in] socket_path Unix domain socket to listen on, stdin/stdout if nullptr
+ * @return int 0 if no errors
+ */
+static int run_server(const char *model_path, const char *socket_path)
+{
+    NeuralNetwork network;
+    int ret = network.load(model_path);
+    if (ret != 0)
+    {
+        std::cerr << "could not load model " << model_path << ": " << ret << std::endl;
+        return 1;
+    }
+    InferenceServer::Config config;
+    InferenceServer server(network, config);
+    if (socket_path == nullptr)
+    {
+        server.serve_fd(STDIN_FILENO, STDOUT_FILENO);
+    }
+    else
+    {
+        std::cerr << "listening on " << socket_path << std::endl;
+        ret = server.serve_socket(socket_path);
+        if (ret != 0)
+        {
+            std::cerr << "could not listen on " << socket_path << std::endl;
+            return 1;
+        }
+    }
+    server.stop();
+    server.print_stats(std::cerr);
+    return 0;
+}
+
+/**
+ * @brief compares Hogwild training with the serial trainer on a wide network
+ *        with sparse inputs (5 % non-zero), prints throughput and final error.
+ *
+ * @param[in] max_threads largest number of Hogwild workers, doubled from 1
+ * @return int 0 if no errors
+ */
+static int run_hogwild_bench(const std::size_t max_threads)
+{
+    const std::size_t num_inputs = 1024;
+    const std::size_t num_outputs = 4;
+    const std::size_t num_samples = 4000;
+    const std::size_t num_epochs = 5;
+    const double learning_rate = 0.01;
+    Rng rng(1);
+    std::vector<std::vector<double>> train_in(num_samples, std::vector<double>(num_inputs, 0.0));
+    std::vector<std::vector<double>> train_out(num_samples, std::vector<double>(num_outputs, 0.0));
+    for (std::size_t i = 0; i < num_samples; i++)
+    {
+        for (std::size_t k = 0; k < num_inputs / 20; k++)
+        {
+            const std::size_t j = rng.bounded(num_inputs);
+            train_in[i][j] = 1.0;
+            train_out[i][j % num_outputs] += 0.1;
+        }
+        for (auto &y : train_out[i])
+        {
+            y = tanh(y);
+        }
+    }
+
+    std::cout << "-=( hogwild benchmark )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_samples << " samples, " << num_inputs << " inputs (5 % non-zero), "
+              << num_epochs << " epochs, 1 hidden layer of 64 nodes\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(10) << "trainer" << std::setw(10) << "threads"
+              << std::setw(16) << "samples/s" << "mse\n";
+    for (std::size_t threads = 0; threads <= max_threads; threads = threads == 0 ? 1 : threads * 2)
+    {
+        NeuralNetwork network(num_inputs, 1, 64, num_outputs);
+        network.init_weights(init_option::XAVIER, 42);
+        network.set_training_data(train_in, train_out);
+        const auto start = std::chrono::steady_clock::now();
+        if (threads == 0)
+        {
+            network.train(num_epochs, learning_rate);
+        }
+        else
+        {
+            network.train_hogwild(num_epochs, learning_rate, threads);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::setw(10) << (threads == 0 ? "serial" : "hogwild") << std::setw(10) << (threads == 0 ? 1 : threads)
+                  << std::setw(16) << (std::size_t)(num_samples * num_epochs / elapsed.count())
+                  << network.mean_squared_error() << "\n";
+    }
+    std::cout << std::right << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return 0;
+}
+
+/**
+ * @brief prints the estimated memory of a network topology before anything is allocated
+ *
+ * @param[in] topology number of inputs, nodes of each hidden layer and number of outputs
+ * @param[in] num_samples number of training samples
+ * @param[in] batch_size number of samples processed at once
+ * @return int 0 if no errors
+ */
+static int run_memory_estimate(const std::vector<std::size_t> &topology,
+                               const std::size_t num_samples,
+                               const std::size_t batch_size)
+{
+    std::cout << "estimated memory for " << num_samples << " samples, batch size " << batch_size << ":\n";
+    MemoryTracker::print_usage(NeuralNetwork::estimate_memory(topology, num_samples, batch_size));
+    return 0;
+}
+
+/**
+ * @brief times every convolution algorithm on a bitmap and prints the
+ *        choice the autotuner makes (and stores) for its shape
+ *
+ * @param[in] bmp_path bitmap to convolute
+ * @param[in] kernel_size kernel size
+ * @param[in] stride stride as passed to convolute
+ * @return int 0 if no errors
+ */
+static int run_conv_tuning(const char *bmp_path, const uint8_t kernel_size, const uint8_t stride)
+{
+    std::string content;
+    FeatureMap<uint8_t> image;
+    int ret = ConvLayer::read_file(bmp_path, content);
+    if (ret == 0)
+    {
+        ret = ConvLayer::import_image_from_memory(content, image);
+    }
+    if (ret != 0)
+    {
+        std::cout << "import error: " << ret << std::endl;
+        return 1;
+    }
+    ConvLayer kernel;
+    kernel.init_kernel(kernel_size);
+    std::cout << image.height() << "x" << image.width() << " image, kernel " << (int)kernel_size
+              << ", stride " << (int)stride << ":\n";
+    ConvTuner::print_timings(ConvTuner::benchmark(image.data().data(), image.height(), image.width(),
+                                                  kernel.get_kernel(), stride, true));
+    const std::size_t num_tuned = ConvTuner::instance().num_tuned();
+    const auto algorithm = ConvTuner::instance().select(image.data().data(), image.height(), image.width(),
+                                                        kernel.get_kernel(), stride, true);
+    std::cout << "selected: " << ConvTuner::algorithm_name(algorithm)
+              << (ConvTuner::instance().num_tuned() > num_tuned ? " (tuned now)" : " (from cache)") << std::endl;
+    return 0;
+}
+
+/**
+ * @brief trains a deep network with mini-batches, keeping every activation
+ *        and with activation checkpointing, and reports memory and throughput
+ *
+ * @param[in] num_hidden_layers number of hidden layers of 128 nodes
+ * @param[in] batch_size samples per batch
+ * @return int 0 if no errors, 1 if the modes give different weights
+ */
+static int run_checkpointing_bench(const std::size_t num_hidden_layers, const std::size_t batch_size)
+{
+    const std::size_t num_inputs = 64;
+    const std::size_t num_outputs = 4;
+    const std::size_t num_samples = 512;
+    const std::size_t num_epochs = 1;
+    Rng rng(3);
+    std::vector<std::vector<double>> train_in(num_samples, std::vector<double>(num_inputs, 0.0));
+    std::vector<std::vector<double>> train_out(num_samples, std::vector<double>(num_outputs, 0.0));
+    for (std::size_t i = 0; i < num_samples; i++)
+    {
+        for (auto &x : train_in[i])
+        {
+            x = rng.bounded(1000) / 1000.0;
+        }
+        train_out[i][i % num_outputs] = 1.0;
+    }
+
+    const std::size_t num_layers = num_hidden_layers + 1;
+    const std::size_t sqrt_layers = (std::size_t)ceil(sqrt((double)num_layers));
+    std::cout << "-=( activation checkpointing )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_samples << " samples, " << num_inputs << " inputs, " << num_hidden_layers
+              << " hidden layers of 128 nodes, batch size " << batch_size << ", " << num_epochs << " epochs\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(18) << "checkpoint every" << std::right
+              << std::setw(16) << "activations" << std::setw(16) << "peak heap" << std::setw(12) << "recomputed"
+              << std::setw(12) << "samples/s" << std::setw(12) << "mse" << "\n";
+    double first_mse = -1.0;
+    bool same = true;
+    for (const std::size_t checkpoint_every : {(std::size_t)0, sqrt_layers, (std::size_t)2})
+    {
+        NeuralNetwork network(num_inputs, num_hidden_layers, 128, num_outputs);
+        network.init_weights(init_option::XAVIER, 42);
+        network.set_training_data(train_in, train_out);
+        MemoryTracker::reset_peak();
+        const std::size_t start_bytes = MemoryTracker::current_bytes();
+        const auto stats = network.train_batched(num_epochs, 0.01, batch_size, checkpoint_every);
+        const std::size_t peak_bytes = MemoryTracker::peak_bytes() - start_bytes;
+        const double mse = network.mean_squared_error();
+        same = same && (first_mse < 0.0 || mse == first_mse);
+        first_mse = first_mse < 0.0 ? mse : first_mse;
+        std::cout << std::left << std::setw(18) << (checkpoint_every == 0 ? std::string("off") : std::to_string(checkpoint_every))
+                  << std::right << std::setw(16) << stats.activation_bytes << std::setw(16)
+                  << (MemoryTracker::enabled() ? std::to_string(peak_bytes) : "-") << std::setw(12)
+                  << stats.recomputed_layers << std::setw(12) << (std::size_t)stats.samples_per_second
+                  << std::setw(12) << mse << "\n";
+    }
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return same ? 0 : 1;
+}
+
+/**
+ * @brief extracts the features of a bitmap while it is read and shows the
+ *        memory used, compared with loading the whole file
+ *
+ * @param[in] bmp_path path to a 24-bit bitmap
+ * @param[in] band_rows rows read from the file at a time, 0 for the kernel size
+ * @param[in] compare true to also load the whole file and check the features
+ * @return int 0 if no errors
+ */
+static int run_stream(const char *bmp_path, const std::size_t band_rows, const bool compare)
+{
+    ConvLayer::PipelineConfig config;
+    config.compact_storage = true;
+    std::vector<double> features;
+    MemoryTracker::reset_peak();
+    const std::size_t start_bytes = MemoryTracker::current_bytes();
+    int ret = ConvLayer::stream_features(bmp_path, config, features, band_rows);
+    if (ret != 0)
+    {
+        std::cout << "import error: " << ret << std::endl;
+        return 1;
+    }
+    std::cout << "streamed " << features.size() << " features";
+    if (MemoryTracker::enabled())
+    {
+        std::cout << ", peak heap " << MemoryTracker::peak_bytes() - start_bytes << " bytes ("
+                  << features.capacity() * sizeof(double) << " of them features)";
+    }
+    std::cout << std::endl;
+    if (!compare)
+    {
+        return 0;
+    }
+
+    std::string content;
+    std::vector<double> loaded_features;
+    MemoryTracker::reset_peak();
+    ret = ConvLayer::read_file(bmp_path, content);
+    if (ret == 0)
+    {
+        ret = ConvLayer::extract_features(content, config, loaded_features);
+    }
+    if (ret != 0)
+    {
+        std::cout << "import error: " << ret << std::endl;
+        return 1;
+    }
+    std::cout << "loaded   " << loaded_features.size() << " features";
+    if (MemoryTracker::enabled())
+    {
+        std::cout << ", peak heap " << MemoryTracker::peak_bytes() - start_bytes << " bytes";
+    }
+    std::cout << ", " << (loaded_features == features ? "features match" : "features differ") << std::endl;
+    return loaded_features == features ? 0 : 1;
+}
+
+/**
+ * @brief compares the latency of NeuralNetwork::predict with a StaticNetwork
+ *        holding the same weights, the network of the demo (49 inputs, hidden
+ *        layers of 49, 10, 10 and 10 nodes, 4 outputs)
+ *
+ * @param[in] num_iterations number of timed predictions per network
+ * @return int 0 if no errors, 1 if the predictions differ
+ */
+static int run_static_bench(const std::size_t num_iterations)
+{
+    NeuralNetwork network(7*7, 0, 0, 4, activation_option::TANH);
+    network.add_hidden_layers(3, 10, activation_option::TANH);
+    network.init_weights(init_option::XAVIER, 42);
+    static StaticNetwork<49, 49, 10, 10, 10, 4> static_network;
+    if (static_network.load(network) != 0)
+    {
+        std::cout << "topology mismatch" << std::endl;
+        return 1;
+    }
+
+    Rng rng(7);
+    std::vector<std::vector<double>> inputs(64, std::vector<double>(49, 0.0));
+    for (auto &input : inputs)
+    {
+        for (auto &x : input)
+        {
+            x = (double)rng.bounded(256);
+        }
+        const auto &expected = network.predict(input);
+        const auto &actual = static_network.predict(input.data());
+        // predict adds in several lanes with the vector kernels, the static loops in index order
+        auto close = [](const double a, const double b)
+        { return fabs(a - b) <= 1e-12; };
+        if (!std::equal(expected.begin(), expected.end(), actual.begin(), close))
+        {
+            std::cout << "static prediction differs from NeuralNetwork::predict" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<double> latencies_ns(num_iterations);
+    double checksum = 0.0;
+    auto measure = [&](const char *name, auto predict)
+    {
+        const std::size_t start_allocations = MemoryTracker::thread_allocations();
+        for (std::size_t i = 0; i < num_iterations; i++)
+        {
+            const uint64_t start_ns = Profiler::now_ns();
+            checksum += predict(inputs[i % inputs.size()])[0];
+            latencies_ns[i] = (double)(Profiler::now_ns() - start_ns);
+        }
+        const std::size_t num_allocations = MemoryTracker::thread_allocations() - start_allocations;
+        double sum = 0.0;
+        for (const auto latency : latencies_ns)
+        {
+            sum += latency;
+        }
+        std::cout << std::left << std::setw(10) << name << std::right << std::setw(10)
+                  << (std::size_t)(sum / num_iterations) << std::setw(10)
+                  << (std::size_t)InferenceServer::percentile(latencies_ns, 0.50) << std::setw(10)
+                  << (std::size_t)InferenceServer::percentile(latencies_ns, 0.99) << std::setw(10)
+                  << (std::size_t)InferenceServer::percentile(latencies_ns, 1.0) << std::setw(14)
+                  << (MemoryTracker::enabled() ? std::to_string(num_allocations) : "n/a") << "\n";
+    };
+
+    std::cout << "-=( static network benchmark )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_iterations << " predictions, 49-49-10-10-10-4, latency in ns\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(10) << "network" << std::right << std::setw(10) << "mean"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(14)
+              << "allocations" << "\n";
+    measure("dynamic", [&network](const std::vector<double> &input) -> const std::vector<double> &
+            { return network.predict(input); });
+    measure("static", [](const std::vector<double> &input) -> const std::array<double, 4> &
+            { return static_network.predict(input.data()); });
+    std::cout << "(checksum " << checksum << ")\n";
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return 0;
+}
+
+/**
+ * @brief online learning with a growing Dataset: samples arrive one at a time
+ *        and are appended to the training data, every 1/8 of the samples the
+ *        network trains one epoch on everything seen so far. The final data is
+ *        saved, mapped back without copying and trained on again from the same
+ *        weights, the result has to match training on the owned copy.
+ *
+ * @param[in] num_samples number of samples that arrive
+ * @param[in] dataset_path file written by Dataset::save
+ * @return int 0 if no errors, 1 if the file can't be written or mapped, 2 if the results differ
+ */
+static int run_online(const std::size_t num_samples, const char *dataset_path)
+{
+    const std::size_t num_inputs = 32;
+    const std::size_t num_outputs = 2;
+    const double learning_rate = 0.01;
+    NeuralNetwork network(num_inputs, 1, 32, num_outputs);
+    network.init_weights(init_option::XAVIER, 42);
+
+    std::cout << "-=( online learning )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(12) << "samples" << std::setw(16) << "append ns"
+              << std::setw(16) << "dataset bytes" << "mse\n";
+    Rng rng(7);
+    std::vector<double> input(num_inputs);
+    std::vector<double> target(num_outputs);
+    const std::size_t step = num_samples < 8 ? 1 : num_samples / 8;
+    uint64_t append_ns = 0;
+    for (std::size_t i = 1; i <= num_samples; i++)
     {
-        usleep(1000 * 20); // to prevent 100% cpu usage
+        double sum = 0.0;
+        for (auto &x : input)
+        {
+            x = (double)rng.bounded(1000) / 1000.0;
+            sum += x;
+        }
+        target[0] = tanh(sum / num_inputs);
+        target[1] = tanh(input[0] - input[1]);
+        const uint64_t start_ns = Profiler::now_ns();
+        network.add_training_sample(input.data(), target.data());
+        append_ns += Profiler::now_ns() - start_ns;
+        if (i % step == 0 || i == num_samples)
+        {
+            network.train(1, learning_rate);
+            std::cout << std::setw(12) << i << std::setw(16) << append_ns / i << std::setw(16)
+                      << network.get_training_data().memory_usage() << network.mean_squared_error() << "\n";
+        }
     }
 
+    if (network.get_training_data().save(dataset_path) != 0)
+    {
+        std::cout << "can't write " << dataset_path << std::endl;
+        return 1;
+    }
+    Dataset mapped;
+    if (mapped.map(dataset_path) != 0)
+    {
+        std::cout << "can't map " << dataset_path << std::endl;
+        return 1;
+    }
+    // both networks start from the same weights and training order
+    const Dataset owned = network.get_training_data();
+    network.set_training_data(owned);
+    NeuralNetwork copy = network;
+    network.train(2, learning_rate);
+    copy.set_training_data(mapped);
+    copy.train(2, learning_rate);
+    const bool same = network.mean_squared_error() == copy.mean_squared_error();
+    std::cout << "mapped " << dataset_path << " (" << mapped.size() << " samples, "
+              << mapped.memory_usage() << " bytes copied), 2 more epochs: mse "
+              << copy.mean_squared_error() << (same ? " (same as owned)\n" : " (DIFFERS from owned)\n");
+    std::cout << std::right << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return same ? 0 : 2;
+}
+
+/**
+ * @brief trains a ConvLayer kernel and a network end to end on 12x12 images
+ *        with a horizontal or a vertical bar, and compares it with the fixed
+ *        0.5 kernel. Half of the images are used for training, the other half
+ *        for the accuracy and loss.
+ *
+ * @param[in] num_epochs number of training epochs
+ * @return int 0 if no errors
+ */
+static int run_conv_training(const std::size_t num_epochs)
+{
+    const std::size_t size = 12;
+    const std::size_t num_images = 512;
+    const double learning_rate = 0.02;
+    Rng rng(11);
+    std::vector<FeatureMap<double>> images(num_images, FeatureMap<double>(size, size));
+    std::vector<std::vector<double>> targets(num_images, std::vector<double>(2, 0.0));
+    for (std::size_t i = 0; i < num_images; i++)
+    {
+        for (std::size_t y = 0; y < size; y++)
+        {
+            for (std::size_t x = 0; x < size; x++)
+            {
+                images[i](y, x) = (double)rng.bounded(400) / 1000.0;
+            }
+        }
+        const bool vertical = rng.bounded(2) == 1;
+        const std::size_t first = rng.bounded(size - 5);
+        const std::size_t line = rng.bounded(size);
+        for (std::size_t k = first; k < first + 5; k++)
+        {
+            (vertical ? images[i](k, line) : images[i](line, k)) = 1.0;
+        }
+        targets[i][vertical ? 1 : 0] = 1.0;
+    }
+
+    ConvLayer::PipelineConfig config;
+    std::cout << "-=( conv training )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_images / 2 << " training and " << num_images / 2 << " test images of a horizontal or vertical bar, "
+              << "3x3 conv, 2x2 max pooling, 1 hidden layer of 16 nodes\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(10) << "kernel" << std::setw(10) << "epochs"
+              << std::setw(12) << "accuracy" << "loss\n";
+    for (const bool trainable : {false, true})
+    {
+        ConvLayer conv;
+        std::vector<double> features;
+        conv.feedforward(images[0], config, features);
+        NeuralNetwork network(features.size(), 1, 16, 2);
+        network.init_weights(init_option::XAVIER, 42);
+        std::vector<double> feature_error(features.size());
+
+        for (std::size_t epoch = 1; epoch <= num_epochs; epoch++)
+        {
+            for (std::size_t i = 0; i < num_images / 2; i++)
+            {
+                conv.feedforward(images[i], config, features);
+                network.train_step(features.data(), targets[i].data(), learning_rate,
+                                   trainable ? feature_error.data() : nullptr);
+                if (trainable)
+                {
+                    conv.backpropagate(feature_error.data());
+                    conv.optimize(learning_rate);
+                }
+            }
+            if (epoch % 10 != 0 && epoch != num_epochs)
+            {
+                continue;
+            }
+            EvaluationResult result(2);
+            for (std::size_t i = num_images / 2; i < num_images; i++)
+            {
+                conv.feedforward(images[i], config, features);
+                result.add(network.predict(features).data(), targets[i].data());
+            }
+            result.finish(0.0);
+            std::cout << std::setw(10) << (trainable ? "trained" : "fixed") << std::setw(10) << epoch
+                      << std::setw(12) << result.accuracy << result.loss << "\n";
+        }
+        if (trainable)
+        {
+            std::cout << std::right << "the trained kernel:" << std::endl;
+            conv.print(ConvLayer::PrintOption::KERNEL);
+        }
+    }
+    std::cout << std::right << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return 0;
+}
+
+/**
+ * @brief returns the largest difference of a weight or bias between two
+ *        networks of the same topology
+ *
+ * @param[in] a first network
+ * @param[in] b second network
+ * @return double
+ */
+static double max_weight_difference(const NeuralNetwork &a, const NeuralNetwork &b)
+{
+    double difference = 0.0;
+    for (std::size_t i = 0; i <= a.get_hidden_layers().size(); i++)
+    {
+        const bool hidden = i < a.get_hidden_layers().size();
+        const DenseLayer &x = hidden ? a.get_hidden_layers()[i] : a.get_output_layer();
+        const DenseLayer &y = hidden ? b.get_hidden_layers()[i] : b.get_output_layer();
+        for (std::size_t n = 0; n < x.num_nodes(); n++)
+        {
+            difference = std::max(difference, fabs(x.bias[n] - y.bias[n]));
+            for (std::size_t j = 0; j < x.num_weights(); j++)
+            {
+                difference = std::max(difference, fabs(x.weights[n][j] - y.weights[n][j]));
+            }
+        }
+    }
+    return difference;
+}
+
+/**
+ * @brief trains the same network with train_batched in this process and with
+ *        1, 2, 4 .. max_workers worker processes connected by a ring allreduce,
+ *        and prints the throughput, the communication time and the largest
+ *        weight difference to the single-process run.
+ *
+ * @param[in] max_workers largest number of worker processes
+ * @param[in] num_epochs number of epochs
+ * @param[in] batch_size samples per weight update over all workers
+ * @return int 0 if no errors, 1 if a distributed run failed or differs
+ */
+static int run_distributed_bench(const std::size_t max_workers, const std::size_t num_epochs,
+                                 const std::size_t batch_size)
+{
+    const std::size_t num_inputs = 64;
+    const std::size_t num_outputs = 4;
+    const std::size_t num_samples = 1024;
+    const double learning_rate = 0.05;
+    Rng rng(3);
+    std::vector<std::vector<double>> train_in(num_samples, std::vector<double>(num_inputs, 0.0));
+    std::vector<std::vector<double>> train_out(num_samples, std::vector<double>(num_outputs, 0.0));
+    for (std::size_t i = 0; i < num_samples; i++)
+    {
+        for (auto &x : train_in[i])
+        {
+            x = rng.bounded(1000) / 1000.0;
+        }
+        train_out[i][(std::size_t)(train_in[i][0] * num_outputs)] = 1.0;
+    }
+    NeuralNetwork initial(num_inputs, 2, 128, num_outputs);
+    initial.init_weights(init_option::XAVIER, 42);
+    initial.set_training_data(train_in, train_out);
+
+    std::cout << "-=( distributed training )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_samples << " samples, 64-128-128-4, batch size " << batch_size << ", " << num_epochs
+              << " epochs, ring allreduce over Unix socket pairs\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(10) << "workers" << std::right << std::setw(12)
+              << "samples/s" << std::setw(12) << "comm s" << std::setw(12) << "waited s" << std::setw(14)
+              << "sent bytes" << std::setw(14) << "mse" << std::setw(16) << "max difference" << "\n";
+    NeuralNetwork reference = initial;
+    const auto batched = reference.train_batched(num_epochs, learning_rate, batch_size);
+    std::cout << std::left << std::setw(10) << "batched" << std::right << std::setw(12)
+              << (std::size_t)batched.samples_per_second << std::setw(12) << "-" << std::setw(12) << "-"
+              << std::setw(14) << "-" << std::setw(14) << reference.mean_squared_error() << std::setw(16) << "-"
+              << "\n";
+    bool ok = true;
+    for (std::size_t workers = 1; workers <= max_workers; workers *= 2)
+    {
+        NeuralNetwork network = initial;
+        NeuralNetwork::DistributedTrainingStats stats;
+        const int ret = DistributedTrainer::launch(network, workers, num_epochs, learning_rate, batch_size, &stats);
+        if (ret != 0)
+        {
+            std::cout << std::left << std::setw(10) << workers << "failed with error " << ret << std::right << "\n";
+            ok = false;
+            continue;
+        }
+        const double difference = max_weight_difference(network, reference);
+        ok = ok && difference < 1e-9;
+        std::cout << std::left << std::setw(10) << workers << std::right << std::setw(12)
+                  << (std::size_t)stats.samples_per_second << std::setw(12) << stats.communication_seconds
+                  << std::setw(12) << stats.wait_seconds << std::setw(14) << stats.bytes_sent << std::setw(14)
+                  << network.mean_squared_error() << std::setw(16) << difference << "\n";
+    }
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief trains the same network with the kernels of every instruction set the
+ *        CPU supports and compares speed and result with the scalar kernels.
+ *
+ * @param[in] num_epochs number of training epochs per instruction set
+ * @return int 0 if every set matches the scalar result up to rounding
+ */
+static int run_kernel_bench(const std::size_t num_epochs)
+{
+    const std::size_t num_inputs = 64;
+    const std::size_t num_outputs = 4;
+    const std::size_t num_samples = 512;
+    const double learning_rate = 0.01;
+    Rng rng(5);
+    std::vector<std::vector<double>> train_in(num_samples, std::vector<double>(num_inputs, 0.0));
+    std::vector<std::vector<double>> train_out(num_samples, std::vector<double>(num_outputs, 0.0));
+    for (std::size_t i = 0; i < num_samples; i++)
+    {
+        for (auto &x : train_in[i])
+        {
+            x = rng.bounded(1000) / 1000.0;
+        }
+        train_out[i][(std::size_t)(train_in[i][0] * num_outputs)] = 1.0;
+    }
+    NeuralNetwork initial(num_inputs, 2, 128, num_outputs);
+    initial.init_weights(init_option::XAVIER, 42);
+    initial.set_sparse_threshold(0.0);
+    initial.set_training_data(train_in, train_out);
+
+    Kernels &kernels = Kernels::instance();
+    const isa_option selected = kernels.isa();
+    std::cout << "-=( kernels )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_samples << " samples, 64-128-128-4, " << num_epochs << " epochs, detected "
+              << Kernels::isa_name(Kernels::detect()) << ", selected " << Kernels::isa_name(selected) << "\n";
+    std::cout << std::setfill(' ') << std::left << std::setw(10) << "isa" << std::right << std::setw(14)
+              << "train s" << std::setw(12) << "speedup" << std::setw(14) << "mse" << std::setw(16)
+              << "max difference" << "\n";
+    NeuralNetwork reference;
+    double scalar_seconds = 0.0;
+    bool ok = true;
+    for (const isa_option isa : {isa_option::SCALAR, isa_option::SSE42, isa_option::AVX2, isa_option::AVX512})
+    {
+        if (kernels.select(isa) != 0)
+        {
+            std::cout << std::left << std::setw(10) << Kernels::isa_name(isa) << "not supported" << std::right << "\n";
+            continue;
+        }
+        NeuralNetwork network = initial;
+        const uint64_t start_ns = Profiler::now_ns();
+        network.train(num_epochs, learning_rate);
+        const double seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+        if (isa == isa_option::SCALAR)
+        {
+            reference = network;
+            scalar_seconds = seconds;
+        }
+        const double difference = max_weight_difference(network, reference);
+        ok = ok && difference < 1e-9;
+        std::cout << std::left << std::setw(10) << Kernels::isa_name(isa) << std::right << std::setw(14) << seconds
+                  << std::setw(12) << scalar_seconds / seconds << std::setw(14) << network.mean_squared_error()
+                  << std::setw(16) << difference << "\n";
+    }
+    kernels.select(selected);
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief trains the same network for a fixed number of epochs and with a
+ *        TrainingController (validation split, early stopping, best weights)
+ *        and compares time and validation loss.
+ *
+ * @param[in] max_epochs epochs of the fixed run and limit of the controlled run
+ * @param[in] patience epochs without improvement before the controller stops
+ * @param[in] target_loss validation loss to reach, 0 for none
+ * @return int 0 if no errors
+ */
+static int run_early_stopping(const std::size_t max_epochs, const std::size_t patience, const double target_loss)
+{
+    const std::size_t num_inputs = 16;
+    const std::size_t num_outputs = 2;
+    const std::size_t num_train = 256;
+    const std::size_t num_validation = 256;
+    const double learning_rate = 0.02;
+    Rng rng(11);
+    // the class is the sign of x0 + x1, 10 % of the training labels are flipped
+    auto make_sample = [&rng](double *input, double *target, const bool noisy)
+    {
+        for (std::size_t j = 0; j < num_inputs; j++)
+        {
+            input[j] = rng.uniform(-1.0, 1.0);
+        }
+        bool positive = input[0] + input[1] > 0.0;
+        positive = noisy && rng.bounded(10) == 0 ? !positive : positive;
+        target[0] = positive ? 1.0 : 0.0;
+        target[1] = positive ? 0.0 : 1.0;
+    };
+    std::vector<std::vector<double>> train_in(num_train, std::vector<double>(num_inputs, 0.0));
+    std::vector<std::vector<double>> train_out(num_train, std::vector<double>(num_outputs, 0.0));
+    for (std::size_t i = 0; i < num_train; i++)
+    {
+        make_sample(train_in[i].data(), train_out[i].data(), true);
+    }
+    FeatureMap<double> validation_in(num_validation, num_inputs);
+    FeatureMap<double> validation_out(num_validation, num_outputs);
+    for (std::size_t i = 0; i < num_validation; i++)
+    {
+        make_sample(validation_in.row(i), validation_out.row(i), false);
+    }
+    NeuralNetwork initial(num_inputs, 2, 64, num_outputs);
+    initial.init_weights(init_option::XAVIER, 42);
+    initial.set_training_data(train_in, train_out);
+
+    std::cout << "-=( early stopping )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    std::cout << num_train << " training samples (10 % flipped labels), " << num_validation
+              << " validation samples, 16-64-64-2, at most " << max_epochs << " epochs\n";
+    NeuralNetwork fixed = initial;
+    const uint64_t start_ns = Profiler::now_ns();
+    fixed.train(max_epochs, learning_rate);
+    const double fixed_seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+    const EvaluationResult fixed_result = fixed.evaluate(validation_in, validation_out);
+
+    NeuralNetwork controlled = initial;
+    TrainingController::Config config;
+    config.patience = patience;
+    config.target_loss = target_loss;
+    config.stop_at_target = false;
+    TrainingController controller(validation_in, validation_out, config);
+    controlled.train(max_epochs, learning_rate, controller);
+    const EvaluationResult controlled_result = controlled.evaluate(validation_in, validation_out);
+    controller.print();
+
+    std::cout << "\n" << std::setfill(' ') << std::left << std::setw(12) << "run" << std::right << std::setw(10)
+              << "epochs" << std::setw(12) << "seconds" << std::setw(14) << "valid loss" << std::setw(12)
+              << "accuracy" << "\n";
+    std::cout << std::left << std::setw(12) << "fixed" << std::right << std::setw(10) << max_epochs << std::setw(12)
+              << fixed_seconds << std::setw(14) << fixed_result.loss << std::setw(12) << fixed_result.accuracy << "\n";
+    std::cout << std::left << std::setw(12) << "controlled" << std::right << std::setw(10)
+              << controller.report().epochs << std::setw(12) << controller.report().seconds << std::setw(14)
+              << controlled_result.loss << std::setw(12) << controlled_result.accuracy << "\n";
+    std::cout << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
     return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "";
+    ConvTuner::instance().open("conv_tuning.cache");
+    if (mode == "")
+    {
+        return run_demo(nullptr);
+    }
+    else if (mode == "--save-model" && argc == 3)
+    {
+        return run_demo(argv[2]);
+    }
+    else if (mode == "--serve" && (argc == 3 || argc == 4))
+    {
+        return run_server(argv[2], argc == 4 ? argv[3] : nullptr);
+    }
+    else if (mode == "--memory" && argc >= 6 && argc <= 8)
+    {
+        std::vector<std::size_t> topology(1, std::stoul(argv[2]));
+        topology.insert(topology.end(), std::stoul(argv[3]), std::stoul(argv[4]));
+        topology.push_back(std::stoul(argv[5]));
+        return run_memory_estimate(topology, argc > 6 ? std::stoul(argv[6]) : 0, argc > 7 ? std::stoul(argv[7]) : 1);
+    }
+    else if (mode == "--tune-conv" && argc >= 3 && argc <= 5)
+    {
+        return run_conv_tuning(argv[2], argc > 3 ? std::stoul(argv[3]) : 3, argc > 4 ? std::stoul(argv[4]) : 0);
+    }
+    else if (mode == "--hogwild" && argc <= 3)
+    {
+        return run_hogwild_bench(argc == 3 ? std::stoul(argv[2]) : 4);
+    }
+    else if (mode == "--checkpointing" && argc <= 4)
+    {
+        return run_checkpointing_bench(argc > 2 ? std::stoul(argv[2]) : 16, argc > 3 ? std::stoul(argv[3]) : 64);
+    }
+    else if (mode == "--stream" && argc >= 3 && argc <= 5)
+    {
+        return run_stream(argv[2], argc > 3 ? std::stoul(argv[3]) : 0, !(argc > 4 && std::string(argv[4]) == "--no-compare"));
+    }
+    else if (mode == "--online" && argc <= 4)
+    {
+        return run_online(argc > 2 ? std::stoul(argv[2]) : 4096, argc > 3 ? argv[3] : "online.dataset");
+    }
+    else if (mode == "--conv-train" && argc <= 3)
+    {
+        return run_conv_training(argc == 3 ? std::stoul(argv[2]) : 60);
+    }
+    else if (mode == "--distributed" && argc <= 5)
+    {
+        return run_distributed_bench(argc > 2 ? std::stoul(argv[2]) : 4, argc > 3 ? std::stoul(argv[3]) : 2,
+                                     argc > 4 ? std::stoul(argv[4]) : 64);
+    }
+    else if (mode == "--kernels" && argc <= 3)
+    {
+        return run_kernel_bench(argc == 3 ? std::stoul(argv[2]) : 20);
+    }
+    else if (mode == "--early-stop" && argc <= 5)
+    {
+        return run_early_stopping(argc > 2 ? std::stoul(argv[2]) : 200, argc > 3 ? std::stoul(argv[3]) : 10,
+                                  argc > 4 ? std::stod(argv[4]) : 0.1);
+    }
+    else if (mode == "--static" && argc <= 3)
+    {
+        return run_static_bench(argc == 3 ? std::stoul(argv[2]) : 100000);
+    }
+    else if (mode == "--loadgen" && argc >= 4 && argc <= 7)
+    {
+        LoadGenerator load_generator;
+        return load_generator.run(argv[2], argv[3],
+                                  argc > 4 ? std::stoul(argv[4]) : 1000,
+                                  argc > 5 ? std::stoul(argv[5]) : 4,
+                                  argc > 6 ? std::stoul(argv[6]) : 1);
+    }
+
+    std::cout << "usage:\n"
+              << "  " << argv[0] << "                          run the demo\n"
+              << "  " << argv[0] << " --save-model <model>     run the demo and save the trained network\n"
+              << "  " << argv[0] << " --serve <model> [socket] serve predictions on stdin or a Unix socket\n"
+              << "  " << argv[0] << " --loadgen <socket> <bmp> [requests] [connections] [pipeline depth]\n"
+              << "  " << argv[0] << " --hogwild [max threads]  compare Hogwild and serial training\n"
+              << "  " << argv[0] << " --checkpointing [hidden layers] [batch size]\n"
+              << "  " << argv[0] << " --stream <bmp> [band rows] [--no-compare]\n"
+              << "  " << argv[0] << " --online [samples] [dataset file]\n"
+              << "  " << argv[0] << " --conv-train [epochs]     train the conv kernel end to end\n"
+              << "  " << argv[0] << " --distributed [max workers] [epochs] [batch size]\n"
+              << "  " << argv[0] << " --kernels [epochs]        compare the kernels of every instruction set\n"
+              << "  " << argv[0] << " --early-stop [max epochs] [patience] [target loss]\n"
+              << "  " << argv[0] << " --static [iterations]    compare StaticNetwork and NeuralNetwork latency\n"
+              << "  " << argv[0] << " --tune-conv <bmp> [kernel size] [stride]\n"
+              << "  " << argv[0] << " --memory <inputs> <hidden layers> <hidden nodes> <outputs> [samples] [batch size]\n";
+    return 1;
 }
\ No newline at end of file
@@ -8,9 +8,22 @@
 #include <sstream>
 #include <cstring>
 #include <string>
+#include <fstream>
+#include <chrono>
 
 #include "neuralnetwork.hpp"
 #include "denselayer.hpp"
 #include "convlayer.hpp"
+#include "sparsenetwork.hpp"
+#include "featurecache.hpp"
+#include "inferenceserver.hpp"
+#include "loadgenerator.hpp"
+#include "profiler.hpp"
+#include "memorytracker.hpp"
+#include "convtuner.hpp"
+#include "staticnetwork.hpp"
+#include "distributedtrainer.hpp"
+#include "kernels.hpp"
+#include "trainingcontroller.hpp"
 
 #endif /* MAIN_HPP_ */
\ No newline at end of file
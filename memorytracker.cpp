@@ -0,0 +1,304 @@
+#include "memorytracker.hpp"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+
+static std::atomic<int64_t> current_bytes_(0);
+static std::atomic<int64_t> peak_bytes_(0);
+static std::atomic<uint64_t> num_allocations_(0);
+static thread_local uint64_t thread_allocations_ = 0;
+// bytes allocated minus bytes freed by this thread, and its peak for the scopes
+static thread_local int64_t thread_current_bytes_ = 0;
+static thread_local int64_t thread_peak_bytes_ = 0;
+
+/**
+ * @brief returns the statistics of every scope, guarded by scope_mutex()
+ */
+static std::vector<MemoryTracker::ScopeStats> &scope_stats(void)
+{
+    static std::vector<MemoryTracker::ScopeStats> stats;
+    return stats;
+}
+
+static std::mutex &scope_mutex(void)
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+/**
+ * @brief starts a scope, the peak is measured from the bytes the calling
+ *        thread has in use now
+ *
+ * @param[in] name scope name, must be a string literal
+ */
+MemoryTracker::Scope::Scope(const char *name)
+    : name_(name),
+      start_bytes_(thread_current_bytes_),
+      outer_peak_(thread_peak_bytes_)
+{
+    thread_peak_bytes_ = thread_current_bytes_;
+}
+
+/**
+ * @brief ends the scope, records its peak and restores the peak of the enclosing scope
+ *
+ */
+MemoryTracker::Scope::~Scope()
+{
+    const int64_t peak = thread_peak_bytes_;
+    const std::size_t scope_peak = peak > this->start_bytes_ ? peak - this->start_bytes_ : 0;
+    {
+        std::lock_guard<std::mutex> lock(scope_mutex());
+        ScopeStats *stats = nullptr;
+        for (auto &scope : scope_stats())
+        {
+            if (scope.name == this->name_ || std::strcmp(scope.name, this->name_) == 0)
+            {
+                stats = &scope;
+                break;
+            }
+        }
+        if (stats == nullptr)
+        {
+            scope_stats().push_back({this->name_, 0, 0});
+            stats = &scope_stats().back();
+        }
+        stats->calls++;
+        stats->peak_bytes = std::max(stats->peak_bytes, scope_peak);
+    }
+    thread_peak_bytes_ = std::max(peak, this->outer_peak_);
+}
+
+/**
+ * @brief returns true if the program is built with ENABLE_MEMORY_TRACKING
+ *
+ * @return bool
+ */
+bool MemoryTracker::enabled(void)
+{
+#ifdef ENABLE_MEMORY_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief returns the number of heap bytes in use (0 without tracking)
+ *
+ * @return std::size_t
+ */
+std::size_t MemoryTracker::current_bytes(void)
+{
+    return current_bytes_.load();
+}
+
+/**
+ * @brief returns the highest number of heap bytes in use since the last reset_peak
+ *
+ * @return std::size_t
+ */
+std::size_t MemoryTracker::peak_bytes(void)
+{
+    return peak_bytes_.load();
+}
+
+/**
+ * @brief returns the number of allocations so far
+ *
+ * @return std::size_t
+ */
+std::size_t MemoryTracker::num_allocations(void)
+{
+    return num_allocations_.load();
+}
+
+/**
+ * @brief returns the number of operator new calls made by the calling thread
+ *        (0 without tracking)
+ *
+ * @return std::size_t
+ */
+std::size_t MemoryTracker::thread_allocations(void)
+{
+    return thread_allocations_;
+}
+
+/**
+ * @brief sets the peak to the bytes in use now
+ *
+ */
+void MemoryTracker::reset_peak(void)
+{
+    peak_bytes_ = current_bytes_.load();
+}
+
+/**
+ * @brief counts an allocation, called by the replaced operator new
+ *
+ * @param[in] size bytes allocated
+ */
+void MemoryTracker::record_allocation(const std::size_t size)
+{
+    const int64_t current = current_bytes_.fetch_add(size) + size;
+    int64_t peak = peak_bytes_.load(std::memory_order_relaxed);
+    while (peak < current && !peak_bytes_.compare_exchange_weak(peak, current))
+    {
+    }
+    num_allocations_++;
+    thread_current_bytes_ += size;
+    thread_peak_bytes_ = std::max(thread_peak_bytes_, thread_current_bytes_);
+}
+
+/**
+ * @brief counts a deallocation, called by the replaced operator delete
+ *
+ * @param[in] size bytes freed
+ */
+void MemoryTracker::record_free(const std::size_t size)
+{
+    current_bytes_.fetch_sub(size);
+    thread_current_bytes_ -= size;
+}
+
+/**
+ * @brief returns a copy of the statistics of every scope
+ *
+ * @return std::vector<ScopeStats>
+ */
+std::vector<MemoryTracker::ScopeStats> MemoryTracker::scopes(void)
+{
+    std::lock_guard<std::mutex> lock(scope_mutex());
+    return scope_stats();
+}
+
+/**
+ * @brief returns the sum of all rows
+ *
+ * @param[in] usage rows from memory_usage() or estimate_memory()
+ * @return std::size_t bytes
+ */
+std::size_t MemoryTracker::total(const std::vector<Usage> &usage)
+{
+    std::size_t sum = 0;
+    for (const auto &row : usage)
+    {
+        sum += row.total();
+    }
+    return sum;
+}
+
+/**
+ * @brief prints the rows as a table in bytes
+ *
+ * @param[in] usage rows from memory_usage() or estimate_memory()
+ * @param[in] ostream chosen output stream
+ */
+void MemoryTracker::print_usage(const std::vector<Usage> &usage, std::ostream &ostream)
+{
+    const std::ios::fmtflags flags = ostream.flags();
+    const char fill = ostream.fill();
+    Usage sum;
+    sum.name = "total";
+    ostream << std::setfill(' ') << std::left << std::setw(20) << "" << std::right
+            << std::setw(12) << "parameters" << std::setw(13) << "activations"
+            << std::setw(12) << "errors" << std::setw(12) << "data" << std::setw(12) << "total" << "\n";
+    auto print_row = [&ostream](const Usage &row)
+    {
+        ostream << std::left << std::setw(20) << row.name << std::right
+                << std::setw(12) << row.parameters << std::setw(13) << row.activations
+                << std::setw(12) << row.errors << std::setw(12) << row.data << std::setw(12) << row.total() << "\n";
+    };
+    for (const auto &row : usage)
+    {
+        print_row(row);
+        sum.parameters += row.parameters;
+        sum.activations += row.activations;
+        sum.errors += row.errors;
+        sum.data += row.data;
+    }
+    print_row(sum);
+    ostream.flags(flags);
+    ostream.fill(fill);
+}
+
+/**
+ * @brief prints the peak of every scope and of the whole program
+ *
+ * @param[in] ostream chosen output stream
+ */
+void MemoryTracker::print_scopes(std::ostream &ostream)
+{
+    if (!enabled())
+    {
+        ostream << "memory tracking disabled, build with make MEMORY=1\n";
+        return;
+    }
+    ostream << "heap in use: " << current_bytes() << " bytes, peak: " << peak_bytes()
+            << " bytes, allocations: " << num_allocations() << "\n";
+    for (const auto &scope : scopes())
+    {
+        ostream << "  " << scope.name << ": peak " << scope.peak_bytes << " bytes above entry, "
+                << scope.calls << " call(s)\n";
+    }
+}
+
+#ifdef ENABLE_MEMORY_TRACKING
+/**
+ * @brief replaced global allocation functions. Every block gets a 16 byte
+ *        header with its size so delete knows how much is freed, 16 bytes
+ *        keeps the alignment malloc guarantees.
+ */
+static const std::size_t MEMORY_HEADER_SIZE = 16;
+
+void *operator new(std::size_t size)
+{
+    char *block = (char *)std::malloc(size + MEMORY_HEADER_SIZE);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    std::memcpy(block, &size, sizeof(size));
+    MemoryTracker::record_allocation(size);
+    thread_allocations_++;
+    return block + MEMORY_HEADER_SIZE;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    char *block = (char *)pointer - MEMORY_HEADER_SIZE;
+    std::size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    MemoryTracker::record_free(size);
+    std::free(block);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+#endif
@@ -0,0 +1,113 @@
+#ifndef MEMORYTRACKER_HPP_
+#define MEMORYTRACKER_HPP_
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+/**
+ * @brief hooks that record the peak heap usage of a region.
+ * @details the hooks expand to nothing unless the program is built with
+ *          -DENABLE_MEMORY_TRACKING (make MEMORY=1), which also replaces the
+ *          global operator new/delete with versions that count every byte
+ *          and the operator new calls of each thread (thread_allocations),
+ *          e.g. to check that a loop doesn't allocate.
+ */
+#ifdef ENABLE_MEMORY_TRACKING
+#define MEMORY_CONCAT_(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_(a, b)
+#define MEMORY_SCOPE(name) MemoryTracker::Scope MEMORY_CONCAT(memory_scope_, __LINE__)((name))
+#else
+#define MEMORY_SCOPE(name) ((void)0)
+#endif
+
+/**
+ * @brief Class for memory accounting of networks and conv pipelines.
+ * @details Usage rows are produced by the memory_usage() and
+ *          estimate_memory() functions of NeuralNetwork and ConvLayer, the
+ *          first measures allocated buffers, the second computes the same
+ *          numbers for a topology before anything is allocated.
+ *
+ *          With ENABLE_MEMORY_TRACKING the heap is counted by the replaced
+ *          operator new/delete and every MEMORY_SCOPE keeps the highest
+ *          number of bytes allocated on top of what was in use when the
+ *          scope was entered. Scopes are counted per thread: a scope only
+ *          sees the allocations and frees of the thread that opened it, so
+ *          scopes open at the same time on other threads don't disturb it,
+ *          and the buffers of threads it starts are not part of its peak.
+ *          current_bytes and peak_bytes are for the whole program.
+ */
+class MemoryTracker
+{
+public:
+    struct Usage
+    {
+        std::string name;
+        std::size_t parameters = 0;
+        std::size_t activations = 0;
+        std::size_t errors = 0;
+        std::size_t data = 0;
+
+        std::size_t total(void) const { return parameters + activations + errors + data; }
+    };
+
+    struct ScopeStats
+    {
+        const char *name;
+        std::size_t calls;
+        std::size_t peak_bytes;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(const char *name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *name_;
+        int64_t start_bytes_;
+        int64_t outer_peak_;
+    };
+
+    static bool enabled(void);
+    static std::size_t current_bytes(void);
+    static std::size_t peak_bytes(void);
+    static std::size_t num_allocations(void);
+    static std::size_t thread_allocations(void);
+    static void reset_peak(void);
+    static void record_allocation(const std::size_t size);
+    static void record_free(const std::size_t size);
+    static std::vector<ScopeStats> scopes(void);
+    static std::size_t total(const std::vector<Usage> &usage);
+    static void print_usage(const std::vector<Usage> &usage, std::ostream &ostream = std::cout);
+    static void print_scopes(std::ostream &ostream = std::cout);
+
+    /**
+     * @brief returns the heap bytes reserved by a vector
+     */
+    template <typename T>
+    static std::size_t bytes(const std::vector<T> &values)
+    {
+        return values.capacity() * sizeof(T);
+    }
+
+    /**
+     * @brief returns the heap bytes reserved by a vector of vectors
+     */
+    template <typename T>
+    static std::size_t bytes(const std::vector<std::vector<T>> &values)
+    {
+        std::size_t sum = values.capacity() * sizeof(std::vector<T>);
+        for (const auto &row : values)
+        {
+            sum += row.capacity() * sizeof(T);
+        }
+        return sum;
+    }
+};
+
+#endif /* MEMORYTRACKER_HPP_ */
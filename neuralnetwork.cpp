@@ -1,4 +1,16 @@
 #include "neuralnetwork.hpp"
+#include "batchqueue.hpp"
+#include "checkpoint.hpp"
+#include "trainingcontroller.hpp"
+#include "ringallreduce.hpp"
+#include "kernels.hpp"
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
 
 /**
  * @brief Construct a new Neural Network object
@@ -61,6 +73,8 @@ void NeuralNetwork::init(const std::size_t num_inputs,
             this->hidden_layers_[i].resize(num_hidden_nodes, num_hidden_nodes);
         }
     }
+    this->apply_sparse_threshold();
+    this->init_weights(this->init_option_, this->seed_);
 }
 
 /**
@@ -105,21 +119,234 @@ void NeuralNetwork::add_hidden_layers(std::size_t num_hidden_layers,
     std::size_t output_layer_nodes = this->output_layer_.num_nodes();
     this->output_layer_.clear();
     this->output_layer_.resize(output_layer_nodes, num_hidden_nodes);
+    this->apply_sparse_threshold();
+    this->init_layer_weights(old_size, 1);
 }
 
 /**
- * @brief initiates training data
+ * @brief sets new weights and biases in every layer and restarts the random
+ *        training order from the same seed.
+ *
+ * @details the rows are split between num_threads threads. Every node draws
+ *          from its own random stream, so the weights only depend on the seed,
+ *          the topology and the scheme, not on the number of threads.
+ *          Layers added later with add_hidden_layers use the same seed and scheme.
+ *
+ * @param[in] io UNIFORM (0 - 1, default), XAVIER or HE
+ * @param[in] seed seed of the run
+ * @param[in] num_threads number of threads used for the initialisation
+ */
+void NeuralNetwork::init_weights(const init_option io,
+                                 const uint64_t seed,
+                                 const std::size_t num_threads)
+{
+    this->init_option_ = io;
+    this->seed_ = seed;
+    this->rng_.seed(seed, SHUFFLE_STREAM);
+    this->init_layer_weights(0, num_threads);
+}
+
+/**
+ * @brief initialises the weights of hidden layer first_layer and all layers
+ *        after it, output layer included.
+ *
+ * @param[in] first_layer index of the first hidden layer to initialise
+ * @param[in] num_threads number of threads used for the initialisation
+ */
+void NeuralNetwork::init_layer_weights(const std::size_t first_layer,
+                                       const std::size_t num_threads)
+{
+    std::vector<DenseLayer *> layers;
+    for (auto &layer : this->hidden_layers_)
+    {
+        layers.push_back(&layer);
+    }
+    layers.push_back(&this->output_layer_);
+
+    std::vector<std::pair<std::size_t, std::size_t>> rows;
+    for (std::size_t layer = first_layer; layer < layers.size(); layer++)
+    {
+        for (std::size_t node = 0; node < layers[layer]->num_nodes(); node++)
+        {
+            rows.push_back({layer, node});
+        }
+    }
+
+    auto init_rows = [&](const std::size_t first_row, const std::size_t last_row)
+    {
+        for (std::size_t row = first_row; row < last_row; row++)
+        {
+            const std::size_t layer = rows[row].first;
+            const std::size_t node = rows[row].second;
+            const std::size_t fan_out = layer + 1 < layers.size() ? layers[layer + 1]->num_nodes() : 0;
+            layers[layer]->init_weights(this->init_option_, this->seed_, layer, fan_out, node, node + 1);
+        }
+    };
+
+    const std::size_t threads = std::max<std::size_t>(1, std::min(num_threads, rows.size()));
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < threads; t++)
+    {
+        workers.emplace_back(init_rows, rows.size() * t / threads, rows.size() * (t + 1) / threads);
+    }
+    init_rows(0, rows.size() / threads);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * @brief sets the input density below which every layer only visits
+ *        its non-zero inputs, see DenseLayer::set_sparse_threshold.
+ *        The threshold is kept for layers created later by
+ *        add_hidden_layers, init or load.
+ *
+ * @param[in] threshold fraction of non-zero inputs (0.0 disables the sparse path)
+ */
+void NeuralNetwork::set_sparse_threshold(const double threshold)
+{
+    this->sparse_threshold_ = threshold;
+    this->apply_sparse_threshold();
+}
+
+/**
+ * @brief gives every layer the threshold from set_sparse_threshold
+ *
+ */
+void NeuralNetwork::apply_sparse_threshold(void)
+{
+    for (auto &layer : this->hidden_layers_)
+    {
+        layer.set_sparse_threshold(this->sparse_threshold_);
+    }
+    this->output_layer_.set_sparse_threshold(this->sparse_threshold_);
+}
+
+/**
+ * @brief sets every weight in the network with a magnitude below the
+ *        threshold to zero.
+ *
+ * @param[in] threshold smallest magnitude that is kept
+ * @return total number of zero weights after pruning
+ */
+std::size_t NeuralNetwork::prune(const double threshold)
+{
+    std::size_t num_zero = 0;
+    for (auto &layer : this->hidden_layers_)
+    {
+        num_zero += layer.prune(threshold);
+    }
+    return num_zero + this->output_layer_.prune(threshold);
+}
+
+/**
+ * @brief keeps the largest fraction of the weights in every layer and
+ *        sets the rest to zero.
+ *
+ * @param[in] keep_fraction fraction of the weights to keep per layer (0.0 - 1.0)
+ * @return total number of zero weights after pruning
+ */
+std::size_t NeuralNetwork::prune_top_k(const double keep_fraction)
+{
+    std::size_t num_zero = 0;
+    for (auto &layer : this->hidden_layers_)
+    {
+        num_zero += layer.prune_top_k(keep_fraction);
+    }
+    return num_zero + this->output_layer_.prune_top_k(keep_fraction);
+}
+
+/**
+ * @brief returns the hidden layers of the network
+ *
+ * @return const std::vector<DenseLayer>&
+ */
+const std::vector<DenseLayer> &NeuralNetwork::get_hidden_layers(void) const
+{
+    return this->hidden_layers_;
+}
+
+/**
+ * @brief returns the output layer of the network
+ *
+ * @return const DenseLayer&
+ */
+const DenseLayer &NeuralNetwork::get_output_layer(void) const
+{
+    return this->output_layer_;
+}
+
+/**
+ * @brief copies training data into one contiguous owned Dataset
  * 
- * @param[in] train_x_in training input data 
- * @param[in] train_yref_out traingin output data (target)
+ * @param[in] train_x_in training input data, one row per sample
+ * @param[in] train_yref_out traingin output data (target), one row per sample
+ * @return int 0 if no errors, 1 if the number of rows differ, 2 if the rows
+ *         differ in size, 3 if the row sizes don't match the network.
+ *         The training data is empty after an error.
+ */
+int NeuralNetwork::set_training_data(const std::vector<std::vector<double>> &train_x_in,
+                                     const std::vector<std::vector<double>> &train_yref_out)
+{
+    int ret = this->train_data_.assign(train_x_in, train_yref_out);
+    if (ret == 0 && train_x_in.size() > 0 && !this->matches_training_data(this->train_data_))
+    {
+        ret = 3;
+    }
+    if (ret != 0)
+    {
+        this->train_data_ = Dataset(this->hidden_layers_[0].num_weights(), this->output_layer_.num_nodes());
+    }
+    this->init_training_order();
+    return ret;
+}
+
+/**
+ * @brief uses a dataset as training data, owned storage is copied while
+ *        borrowed storage (Dataset::view, Dataset::map) is shared
+ *
+ * @param[in] data training samples
+ * @return int 0 if no errors, 3 if the row sizes don't match the network
  */
-void NeuralNetwork::set_training_data(const std::vector<std::vector<double>> &train_x_in,
-                                       const std::vector<std::vector<double>> &train_yref_out)
+int NeuralNetwork::set_training_data(const Dataset &data)
 {
-    this->train_x_in_ = train_x_in;
-    this->train_yref_out_ = train_yref_out;
-    this->check_training_data_size();
+    if (!this->matches_training_data(data))
+    {
+        return 3;
+    }
+    this->train_data_ = data;
     this->init_training_order();
+    return 0;
+}
+
+/**
+ * @brief appends one sample to the training data (online learning), amortized
+ *        O(1). The sample is part of the next epoch.
+ *
+ * @param[in] input one value per network input
+ * @param[in] target one value per network output
+ * @return int 0 if no errors
+ */
+int NeuralNetwork::add_training_sample(const double *input, const double *target)
+{
+    if (this->train_data_.size() == 0 && !this->matches_training_data(this->train_data_))
+    {
+        this->train_data_ = Dataset(this->hidden_layers_[0].num_weights(), this->output_layer_.num_nodes());
+    }
+    this->train_data_.append(input, target);
+    this->train_order_.push_back(this->train_data_.size() - 1);
+    return 0;
+}
+
+/**
+ * @brief returns the training data of the network
+ *
+ * @return const Dataset&
+ */
+const Dataset &NeuralNetwork::get_training_data(void) const
+{
+    return this->train_data_;
 }
 
 /**
@@ -132,46 +359,1030 @@ void NeuralNetwork::set_training_data(const std::vector<std::vector<double>> &tr
 void NeuralNetwork::train(const std::size_t num_epochs,
                            const double learning_rate)
 {
-    for (std::size_t i = 0; i < num_epochs; i++)
+    this->train_epochs(0, num_epochs, learning_rate, nullptr);
+}
+
+/**
+ * @brief trains like train() and lets the checkpointer snapshot the network
+ *        after every epoch, the files are written by its background thread.
+ *
+ * @param[in] num_epochs number of training epochs
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in] checkpointer decides when to checkpoint and writes the files
+ */
+void NeuralNetwork::train(const std::size_t num_epochs,
+                           const double learning_rate,
+                           Checkpointer &checkpointer)
+{
+    this->train_epochs(0, num_epochs, learning_rate, &checkpointer);
+}
+
+/**
+ * @brief trains like train() until the controller stops on a plateau or at
+ *        its target loss, then the controller restores the best weights.
+ *        controller.report() tells why and when training stopped.
+ *
+ * @param[in] num_epochs largest number of training epochs
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in,out] controller validation split and stopping rules
+ */
+void NeuralNetwork::train(const std::size_t num_epochs,
+                           const double learning_rate,
+                           TrainingController &controller)
+{
+    this->train_epochs(0, num_epochs, learning_rate, nullptr, &controller);
+}
+
+/**
+ * @brief continues training from a checkpoint.
+ *
+ * @details restores weights, biases, the random generator and the training
+ *          order, then trains the epochs that were left. The training data
+ *          must be set (the same data as in the interrupted run) before the
+ *          call. The result is identical to a run that was never interrupted.
+ *
+ * @param[in] checkpoint_path checkpoint file written by a Checkpointer
+ * @param[in] num_epochs total number of epochs, including the ones already done
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in] checkpointer optional checkpointer for the rest of the run
+ * @return int 0 if no errors, 1 if the file can't be read, 2 if the format is wrong,
+ *         3 if the topology or training data size doesn't match
+ */
+int NeuralNetwork::resume(const char *checkpoint_path,
+                          const std::size_t num_epochs,
+                          const double learning_rate,
+                          Checkpointer *checkpointer)
+{
+    std::vector<char> buffer;
+    int ret = Checkpointer::read(checkpoint_path, buffer);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    std::size_t epoch = 0;
+    ret = this->load_snapshot(buffer.data(), buffer.size(), epoch);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    this->train_epochs(epoch, num_epochs, learning_rate, checkpointer);
+    return 0;
+}
+
+/**
+ * @brief the training loop shared by train() and resume()
+ *
+ * @details the loss of every epoch is summed from the outputs of the training
+ *          step itself (one subtraction and multiplication per output, no
+ *          extra forward pass) and passed to the controller and the profiler.
+ * @param[in] first_epoch number of epochs already done
+ * @param[in] num_epochs total number of epochs
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in] checkpointer optional checkpointer, nullptr for none
+ * @param[in,out] controller optional training controller, nullptr for none
+ */
+void NeuralNetwork::train_epochs(const std::size_t first_epoch,
+                                 const std::size_t num_epochs,
+                                 const double learning_rate,
+                                 Checkpointer *checkpointer,
+                                 TrainingController *controller)
+{
+    MEMORY_SCOPE("train");
+    if (controller != nullptr)
+    {
+        controller->begin(*this);
+    }
+    for (std::size_t i = first_epoch; i < num_epochs; i++)
     {
+#ifdef ENABLE_PROFILING
+        const uint64_t epoch_start_ns = Profiler::now_ns();
+#endif
+        double epoch_loss = 0.0;
         this->randomize_training_order();
         for (std::size_t j = 0; j < this->train_order_.size(); j++)
         {
             const auto index = this->train_order_[j];
-            const auto &input = this->train_x_in_[index];
-            const auto &reference = this->train_yref_out_[index];
+            const double *input = this->train_data_.input(index);
+            const double *reference = this->train_data_.target(index);
 
-            this->feedforward(input);
+            this->feedforward(input, this->train_data_.num_inputs());
+            for (std::size_t k = 0; k < this->output_layer_.num_nodes(); k++)
+            {
+                const double dev = reference[k] - this->output_layer_.output[k];
+                epoch_loss += dev * dev;
+            }
             this->backpropagate(reference);
-            this->optimize(input, learning_rate);
+            this->optimize(input, this->train_data_.num_inputs(), learning_rate);
+        }
+        const std::size_t num_values = this->train_order_.size() * this->output_layer_.num_nodes();
+        epoch_loss = num_values > 0 ? epoch_loss / num_values : 0.0;
+#ifdef ENABLE_PROFILING
+        PROFILE_EPOCH(i, epoch_loss, this->train_order_.size(), (Profiler::now_ns() - epoch_start_ns) * 1e-9);
+#endif
+        if (checkpointer != nullptr)
+        {
+            checkpointer->maybe_checkpoint(*this, i + 1);
+        }
+        if (controller != nullptr && controller->end_epoch(*this, i + 1, epoch_loss))
+        {
+            break;
+        }
+    }
+    if (checkpointer != nullptr)
+    {
+        checkpointer->wait();
+    }
+    if (controller != nullptr)
+    {
+        controller->finish(*this);
+    }
+}
+
+/**
+ * @brief returns the number of bytes needed by save_snapshot
+ *
+ * @return std::size_t
+ */
+std::size_t NeuralNetwork::snapshot_size(void) const
+{
+    std::size_t num_words = 9 + this->train_order_.size();
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        num_words += 3 + layer.num_nodes() * (layer.num_weights() + 1);
+    }
+    return num_words * sizeof(uint64_t);
+}
+
+/**
+ * @brief copies the complete training state into a buffer of snapshot_size() bytes.
+ * @details plain SGD has no optimizer state besides the epoch, the random
+ *          generator and the training order, so those are stored with the
+ *          weights. Every field is 8 bytes:
+ *          [magic][num layers][epoch][seed][rng state x4][order size][order ...]
+ *          per layer: [num nodes][num weights][activation]
+ *          per layer: [bias ...][weights ...]
+ *
+ * @param[out] buffer destination, snapshot_size() bytes
+ * @param[in] epoch number of completed epochs
+ */
+void NeuralNetwork::save_snapshot(char *buffer, const std::size_t epoch) const
+{
+    auto put = [&buffer](const uint64_t value)
+    {
+        std::memcpy(buffer, &value, sizeof(value));
+        buffer += sizeof(value);
+    };
+    auto put_doubles = [&buffer](const std::vector<double> &values)
+    {
+        std::memcpy(buffer, values.data(), values.size() * sizeof(double));
+        buffer += values.size() * sizeof(double);
+    };
+
+    put(SNAPSHOT_MAGIC);
+    put(this->hidden_layers_.size() + 1);
+    put(epoch);
+    put(this->seed_);
+    for (const auto word : this->rng_.get_state())
+    {
+        put(word);
+    }
+    put(this->train_order_.size());
+    for (const auto index : this->train_order_)
+    {
+        put(index);
+    }
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        put(layer.num_nodes());
+        put(layer.num_weights());
+        put(layer.ao == activation_option::TANH ? 1 : 0);
+    }
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        put_doubles(layer.bias);
+        for (const auto &node_weights : layer.weights)
+        {
+            put_doubles(node_weights);
+        }
+    }
+}
+
+/**
+ * @brief restores a state saved with save_snapshot, the network must have
+ *        the same topology.
+ *
+ * @param[in] buffer snapshot
+ * @param[in] size number of bytes in buffer
+ * @param[out] epoch number of completed epochs
+ * @return int 0 if no errors, 2 if the format is wrong, 3 if the topology or
+ *         training data size doesn't match
+ */
+int NeuralNetwork::load_snapshot(const char *buffer, const std::size_t size, std::size_t &epoch)
+{
+    const char *end = buffer + size;
+    bool ok = true;
+    auto get = [&]() -> uint64_t
+    {
+        uint64_t value = 0;
+        if (end - buffer < (std::ptrdiff_t)sizeof(value))
+        {
+            ok = false;
+            return 0;
+        }
+        std::memcpy(&value, buffer, sizeof(value));
+        buffer += sizeof(value);
+        return value;
+    };
+
+    if (get() != SNAPSHOT_MAGIC)
+    {
+        return 2;
+    }
+    if (get() != this->hidden_layers_.size() + 1)
+    {
+        return 3;
+    }
+    const std::size_t saved_epoch = get();
+    const uint64_t seed = get();
+    std::array<uint64_t, 4> state;
+    for (auto &word : state)
+    {
+        word = get();
+    }
+    if (get() != this->train_order_.size())
+    {
+        return ok ? 3 : 2;
+    }
+    std::vector<std::size_t> order(this->train_order_.size());
+    for (auto &index : order)
+    {
+        index = get();
+        if (index >= order.size())
+        {
+            return 2;
+        }
+    }
+    std::vector<activation_option> activations(this->hidden_layers_.size() + 1);
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        const std::size_t num_nodes = get();
+        const std::size_t num_weights = get();
+        activations[i] = get() == 1 ? activation_option::TANH : activation_option::RELU;
+        if (num_nodes != layer.num_nodes() || num_weights != layer.num_weights())
+        {
+            return ok ? 3 : 2;
+        }
+    }
+    if (!ok || size != this->snapshot_size())
+    {
+        return 2;
+    }
+
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        layer.set_activation(activations[i]);
+        std::memcpy(layer.bias.data(), buffer, layer.num_nodes() * sizeof(double));
+        buffer += layer.num_nodes() * sizeof(double);
+        for (auto &node_weights : layer.weights)
+        {
+            std::memcpy(node_weights.data(), buffer, node_weights.size() * sizeof(double));
+            buffer += node_weights.size() * sizeof(double);
+        }
+    }
+    this->seed_ = seed;
+    this->rng_.set_state(state);
+    this->train_order_ = order;
+    epoch = saved_epoch;
+    return 0;
+}
+
+/**
+ * @brief trains the network like train() while a producer thread prepares
+ *        the next batches.
+ *
+ * @details the producer shuffles the training order, gathers the samples
+ *          of a batch into one contiguous buffer (optionally through
+ *          preprocess, e.g. conv feature extraction) and hands it over
+ *          through a BatchQueue with num_buffers preallocated batches.
+ *          Meanwhile this thread trains sample by sample on the previous
+ *          batch, so as long as the producer keeps up the trainer never
+ *          waits for data. Without preprocess the result is the same as train().
+ *
+ * @param[in] num_epochs number of training epochs
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in] batch_size number of samples per batch
+ * @param[in] num_buffers number of batches in flight (at least 2)
+ * @param[in] preprocess optional function that turns a training sample into network inputs
+ * @return number of times the trainer had to wait for the producer
+ */
+std::size_t NeuralNetwork::train_async(const std::size_t num_epochs,
+                                       const double learning_rate,
+                                       const std::size_t batch_size,
+                                       const std::size_t num_buffers,
+                                       const preprocess_function &preprocess)
+{
+    MEMORY_SCOPE("train_async");
+    const std::size_t num_inputs = this->hidden_layers_[0].num_weights();
+    const std::size_t num_outputs = this->output_layer_.num_nodes();
+    const std::size_t samples_per_batch = batch_size == 0 ? 1 : batch_size;
+    BatchQueue queue(num_buffers, samples_per_batch, num_inputs, num_outputs);
+
+    auto produce = [&]()
+    {
+        for (std::size_t epoch = 0; epoch < num_epochs; epoch++)
+        {
+            this->randomize_training_order();
+            for (std::size_t start = 0; start < this->train_order_.size(); start += samples_per_batch)
+            {
+                PROFILE_SCOPE("produce_batch", -1, 0, 0);
+                BatchQueue::Batch &batch = queue.acquire_free();
+                batch.num_samples = std::min(samples_per_batch, this->train_order_.size() - start);
+                for (std::size_t k = 0; k < batch.num_samples; k++)
+                {
+                    const auto index = this->train_order_[start + k];
+                    const double *input = this->train_data_.input(index);
+                    const double *reference = this->train_data_.target(index);
+                    double *x = &batch.x[k * num_inputs];
+                    if (preprocess)
+                    {
+                        preprocess(input, this->train_data_.num_inputs(), x, num_inputs);
+                    }
+                    else
+                    {
+                        std::copy(input, input + num_inputs, x);
+                    }
+                    std::copy(reference, reference + num_outputs, &batch.y[k * num_outputs]);
+                }
+                queue.publish();
+            }
+        }
+        queue.acquire_free().end = true;
+        queue.publish();
+    };
+    std::thread producer(produce);
+
+    for (;;)
+    {
+        BatchQueue::Batch *batch;
+        {
+            PROFILE_SCOPE("wait_for_batch", -1, 0, 0);
+            batch = &queue.acquire_filled();
+        }
+        if (batch->end)
+        {
+            queue.release();
+            break;
+        }
+        for (std::size_t k = 0; k < batch->num_samples; k++)
+        {
+            const double *input = &batch->x[k * num_inputs];
+            this->feedforward(input, num_inputs);
+            this->backpropagate(&batch->y[k * num_outputs]);
+            this->optimize(input, num_inputs, learning_rate);
+        }
+        queue.release();
+    }
+    producer.join();
+    return queue.consumer_waits();
+}
+
+/**
+ * @brief trains the network with lock-free asynchronous SGD (Hogwild).
+ *
+ * @details every epoch the shuffled training order is split between
+ *          num_threads workers. Each worker runs feedforward and
+ *          backpropagate on its own output and error buffers and applies its
+ *          updates directly to the shared weights without locks. Writes from
+ *          different workers may collide and overwrite each other, which SGD
+ *          tolerates when each sample only touches a small part of the
+ *          weights (sparse inputs). The result depends on the thread timing,
+ *          use train() when the run must be reproducible.
+ *
+ * @param[in] num_epochs number of training epochs
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[in] num_threads number of worker threads
+ */
+void NeuralNetwork::train_hogwild(const std::size_t num_epochs,
+                                  const double learning_rate,
+                                  const std::size_t num_threads)
+{
+    MEMORY_SCOPE("train_hogwild");
+    const std::size_t num_layers = this->hidden_layers_.size() + 1;
+    const std::size_t num_workers = num_threads == 0 ? 1 : num_threads;
+    auto layer = [this](const std::size_t i) -> DenseLayer &
+    {
+        return i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+    };
+
+    auto work = [&](const std::size_t first, const std::size_t last)
+    {
+        std::vector<std::vector<double>> outputs(num_layers);
+        std::vector<std::vector<double>> errors(num_layers);
+        std::vector<std::size_t> nonzero_index;
+        for (std::size_t i = 0; i < num_layers; i++)
+        {
+            outputs[i].resize(layer(i).num_nodes(), 0.0);
+            errors[i].resize(layer(i).num_nodes(), 0.0);
+        }
+
+        for (std::size_t j = first; j < last; j++)
+        {
+            const auto index = this->train_order_[j];
+            const double *input = this->train_data_.input(index);
+            const double *reference = this->train_data_.target(index);
+
+            const double *x = input;
+            std::size_t num_x = this->train_data_.num_inputs();
+            for (std::size_t i = 0; i < num_layers; i++)
+            {
+                layer(i).feedforward(x, num_x, outputs[i].data(), nonzero_index);
+                x = outputs[i].data();
+                num_x = outputs[i].size();
+            }
+
+            this->output_layer_.backpropagate(reference, outputs.back().data(), errors.back().data());
+            for (std::size_t i = num_layers - 1; i-- > 0;)
+            {
+                layer(i).backpropagate(layer(i + 1), errors[i + 1].data(), outputs[i].data(), errors[i].data());
+            }
+
+            x = input;
+            num_x = this->train_data_.num_inputs();
+            for (std::size_t i = 0; i < num_layers; i++)
+            {
+                layer(i).optimize(x, num_x, errors[i].data(), learning_rate, nonzero_index);
+                x = outputs[i].data();
+                num_x = outputs[i].size();
+            }
+        }
+    };
+
+    for (std::size_t epoch = 0; epoch < num_epochs; epoch++)
+    {
+        this->randomize_training_order();
+        const std::size_t num_samples = this->train_order_.size();
+        std::vector<std::thread> workers;
+        for (std::size_t t = 0; t < num_workers; t++)
+        {
+            workers.emplace_back(work, num_samples * t / num_workers, num_samples * (t + 1) / num_workers);
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
         }
     }
 }
 
 /**
- * @brief compairs the size of input and output training data
- * and fix variations betwen them
+ * @brief trains with mini-batches, optionally with activation checkpointing.
+ * @details the layers are split into segments of checkpoint_every layers.
+ *          The forward pass keeps only the output of the last layer of each
+ *          segment (the checkpoint), the backward pass runs the segments in
+ *          reverse and recomputes the outputs of a segment from the previous
+ *          checkpoint before propagating the errors through it. Activation
+ *          memory is batch_size * (checkpoints + checkpoint_every layers)
+ *          instead of batch_size * all layers, at the price of a second
+ *          forward pass for every segment but the last.
+ *
+ *          A layer is updated as soon as the error of the layer below it is
+ *          known, with the mean of the updates of the batch. The recomputed
+ *          segments only use layers that are not updated yet, so every
+ *          checkpoint_every gives the same weights, and batch_size 1 gives the
+ *          same weights as train.
+ *
+ * @param[in] num_epochs number of epochs
+ * @param[in] learning_rate amount of error adjustment
+ * @param[in] batch_size samples per weight update
+ * @param[in] checkpoint_every layers per segment, 0 keeps every layer (no recomputation)
+ * @return BatchTrainingStats activation memory, recomputed layers and throughput
  */
-void NeuralNetwork::check_training_data_size(void)
+NeuralNetwork::BatchTrainingStats NeuralNetwork::train_batched(const std::size_t num_epochs,
+                                                               const double learning_rate,
+                                                               const std::size_t batch_size,
+                                                               const std::size_t checkpoint_every)
 {
+    MEMORY_SCOPE("train_batched");
+    BatchTrainingStats stats;
+    const std::size_t num_layers = this->hidden_layers_.size() + 1;
+    const std::size_t segment_size = checkpoint_every == 0 || checkpoint_every > num_layers ? num_layers
+                                                                                           : checkpoint_every;
+    const std::size_t num_segments = (num_layers + segment_size - 1) / segment_size;
+    const std::size_t max_batch = batch_size == 0 ? 1 : batch_size;
+    auto layer = [this](const std::size_t i) -> DenseLayer &
+    {
+        return i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+    };
+    std::size_t max_nodes = 0;
+    for (std::size_t i = 0; i < num_layers; i++)
+    {
+        max_nodes = std::max(max_nodes, layer(i).num_nodes());
+    }
+
+    // outputs of the segment being processed, one B x nodes matrix per layer
+    std::vector<std::vector<double>> segment(segment_size);
+    std::vector<std::vector<double>> checkpoints(num_segments - 1);
+    std::vector<double> error(max_batch * max_nodes, 0.0);
+    std::vector<double> next_error(max_batch * max_nodes, 0.0);
+    std::vector<std::size_t> nonzero_index;
 
-    if (this->train_x_in_.size() < this->train_yref_out_.size())
+    std::size_t first = 0;
+    std::size_t count = 0;
+    const std::size_t num_inputs = this->train_data_.num_inputs();
+    auto input = [&](const std::size_t b)
     {
-        this->train_yref_out_.resize(this->train_x_in_.size());
+        return this->train_data_.input(this->train_order_[first + b]);
+    };
+
+    auto forward_segment = [&](const std::size_t s)
+    {
+        const std::size_t begin = s * segment_size;
+        const std::size_t end = std::min(begin + segment_size, num_layers);
+        for (std::size_t i = begin; i < end; i++)
+        {
+            const std::size_t num_nodes = layer(i).num_nodes();
+            const std::size_t prev_nodes = i == 0 ? 0 : layer(i - 1).num_nodes();
+            const double *previous = i == begin ? (i == 0 ? nullptr : checkpoints[s - 1].data())
+                                                : segment[i - begin - 1].data();
+            segment[i - begin].resize(count * num_nodes);
+            for (std::size_t b = 0; b < count; b++)
+            {
+                double *output = segment[i - begin].data() + b * num_nodes;
+                if (i == 0)
+                {
+                    layer(i).feedforward(input(b), num_inputs, output, nonzero_index);
+                }
+                else
+                {
+                    layer(i).feedforward(previous + b * prev_nodes, prev_nodes, output, nonzero_index);
+                }
+            }
+        }
+    };
+
+    const uint64_t start_ns = Profiler::now_ns();
+    for (std::size_t epoch = 0; epoch < num_epochs; epoch++)
+    {
+        this->randomize_training_order();
+        for (first = 0; first < this->train_order_.size(); first += count)
+        {
+            count = std::min(max_batch, this->train_order_.size() - first);
+            const double step = learning_rate / count;
+
+            for (std::size_t s = 0; s < num_segments; s++)
+            {
+                forward_segment(s);
+                if (s + 1 < num_segments)
+                {
+                    std::swap(checkpoints[s], segment[segment_size - 1]);
+                }
+            }
+
+            for (std::size_t s = num_segments; s-- > 0;)
+            {
+                const std::size_t begin = s * segment_size;
+                const std::size_t end = std::min(begin + segment_size, num_layers);
+                if (s + 1 < num_segments)
+                {
+                    forward_segment(s);
+                    stats.recomputed_layers += end - begin;
+                }
+                for (std::size_t i = end; i-- > begin;)
+                {
+                    const std::size_t num_nodes = layer(i).num_nodes();
+                    const double *output = segment[i - begin].data();
+                    for (std::size_t b = 0; b < count; b++)
+                    {
+                        if (i == num_layers - 1)
+                        {
+                            layer(i).backpropagate(this->train_data_.target(this->train_order_[first + b]),
+                                                   output + b * num_nodes, error.data() + b * num_nodes);
+                        }
+                        else
+                        {
+                            layer(i).backpropagate(layer(i + 1), next_error.data() + b * layer(i + 1).num_nodes(),
+                                                   output + b * num_nodes, error.data() + b * num_nodes);
+                        }
+                    }
+                    if (i < num_layers - 1)
+                    {
+                        for (std::size_t b = 0; b < count; b++)
+                        {
+                            layer(i + 1).optimize(output + b * num_nodes, num_nodes,
+                                                  next_error.data() + b * layer(i + 1).num_nodes(),
+                                                  step, nonzero_index);
+                        }
+                    }
+                    std::swap(error, next_error);
+                }
+            }
+            for (std::size_t b = 0; b < count; b++)
+            {
+                layer(0).optimize(input(b), num_inputs, next_error.data() + b * layer(0).num_nodes(),
+                                  step, nonzero_index);
+            }
+        }
     }
-    else if (this->train_x_in_.size() > this->train_yref_out_.size())
+
+    stats.seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+    stats.samples_per_second = stats.seconds > 0.0 ? num_epochs * this->train_order_.size() / stats.seconds : 0.0;
+    stats.activation_bytes = MemoryTracker::bytes(segment) + MemoryTracker::bytes(checkpoints) +
+                             MemoryTracker::bytes(error) + MemoryTracker::bytes(next_error);
+    return stats;
+}
+
+/**
+ * @brief data-parallel mini-batch training, one call per process of a ring.
+ * @details every process starts with the same network and training data
+ *          (e.g. forked from one process or mapped from one Dataset file) and
+ *          shuffles the training order with the same generator. Of every batch
+ *          of batch_size samples, rank r only runs its shard, samples
+ *          count * r / num_ranks .. count * (r + 1) / num_ranks - 1. The
+ *          gradients (bias followed by weights per node) of the shard are
+ *          summed over the ring and every process applies the same update,
+ *          the mean of the batch as in train_batched, so the networks stay
+ *          identical and equal train_batched up to the rounding of the sums.
+ *
+ *          The backward pass runs from the output layer down. As soon as the
+ *          gradient of a layer is complete, a communication thread starts its
+ *          allreduce while this thread calculates the next layer below, so
+ *          only the allreduce of the last layers is not hidden.
+ *
+ * @param[in] num_epochs number of epochs
+ * @param[in] learning_rate amount of error adjustment
+ * @param[in] batch_size samples per weight update over all processes
+ * @param[in] ring connection to the other processes
+ * @param[out] stats time spent and hidden in communication, or nullptr
+ * @return int 0 if no errors, 1 if the ring failed (the network is then not
+ *         in sync with the other processes)
+ */
+int NeuralNetwork::train_distributed(const std::size_t num_epochs,
+                                     const double learning_rate,
+                                     const std::size_t batch_size,
+                                     RingAllreduce &ring,
+                                     DistributedTrainingStats *stats)
+{
+    MEMORY_SCOPE("train_distributed");
+    const std::size_t num_layers = this->hidden_layers_.size() + 1;
+    const std::size_t max_batch = batch_size == 0 ? 1 : batch_size;
+    auto layer = [this](const std::size_t i) -> DenseLayer &
+    {
+        return i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+    };
+
+    // per layer: outputs and errors of the shard, one row per sample, and the gradient
+    std::vector<std::vector<double>> outputs(num_layers);
+    std::vector<std::vector<double>> errors(num_layers);
+    std::vector<std::vector<double>> gradients(num_layers);
+    for (std::size_t i = 0; i < num_layers; i++)
     {
-        this->train_x_in_.resize(this->train_yref_out_.size());
+        gradients[i].resize(layer(i).num_nodes() * (layer(i).num_weights() + 1));
     }
+    std::vector<std::size_t> nonzero_index;
+
+    std::mutex mutex;
+    std::condition_variable reduced;
+    std::condition_variable queued;
+    std::size_t num_queued = 0;
+    std::size_t num_reduced = 0;
+    bool stop = false;
+    // written by the communicator, read by the training loop without the lock
+    std::atomic<int> ret(0);
+    // layers are queued from the output layer down, the same order on every rank
+    auto communicate = [&]()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            queued.wait(lock, [&]() { return stop || num_reduced < num_queued; });
+            if (num_reduced == num_queued)
+            {
+                return;
+            }
+            const std::size_t i = num_layers - 1 - num_reduced % num_layers;
+            lock.unlock();
+            const int result = ret == 0 ? ring.allreduce(gradients[i].data(), gradients[i].size()) : 0;
+            if (result != 0)
+            {
+                // the other ranks would wait for this one forever, make their allreduce fail
+                ring.abort();
+            }
+            lock.lock();
+            if (ret == 0)
+            {
+                ret = result;
+            }
+            num_reduced++;
+            reduced.notify_all();
+        }
+    };
+    std::thread communicator(communicate);
+
+    double wait_seconds = 0.0;
+    const uint64_t start_ns = Profiler::now_ns();
+    for (std::size_t epoch = 0; epoch < num_epochs && ret == 0; epoch++)
+    {
+        this->randomize_training_order();
+        for (std::size_t first = 0; first < this->train_order_.size() && ret == 0;)
+        {
+            const std::size_t count = std::min(max_batch, this->train_order_.size() - first);
+            const std::size_t begin = first + count * ring.rank() / ring.num_ranks();
+            const std::size_t end = first + count * (ring.rank() + 1) / ring.num_ranks();
+            const std::size_t num_local = end - begin;
+            auto input = [&](const std::size_t b)
+            {
+                return this->train_data_.input(this->train_order_[begin + b]);
+            };
+            auto layer_input = [&](const std::size_t i, const std::size_t b)
+            {
+                return i == 0 ? input(b) : outputs[i - 1].data() + b * layer(i - 1).num_nodes();
+            };
+
+            for (std::size_t i = 0; i < num_layers; i++)
+            {
+                outputs[i].resize(num_local * layer(i).num_nodes());
+                errors[i].resize(num_local * layer(i).num_nodes());
+                for (std::size_t b = 0; b < num_local; b++)
+                {
+                    layer(i).feedforward(layer_input(i, b), layer(i).num_weights(),
+                                         outputs[i].data() + b * layer(i).num_nodes(), nonzero_index);
+                }
+            }
+
+            for (std::size_t i = num_layers; i-- > 0;)
+            {
+                const std::size_t num_nodes = layer(i).num_nodes();
+                const std::size_t num_weights = layer(i).num_weights();
+                for (std::size_t b = 0; b < num_local; b++)
+                {
+                    double *error = errors[i].data() + b * num_nodes;
+                    if (i == num_layers - 1)
+                    {
+                        layer(i).backpropagate(this->train_data_.target(this->train_order_[begin + b]),
+                                               outputs[i].data() + b * num_nodes, error);
+                    }
+                    else
+                    {
+                        layer(i).backpropagate(layer(i + 1), errors[i + 1].data() + b * layer(i + 1).num_nodes(),
+                                               outputs[i].data() + b * num_nodes, error);
+                    }
+                }
+                std::fill(gradients[i].begin(), gradients[i].end(), 0.0);
+                for (std::size_t b = 0; b < num_local; b++)
+                {
+                    const double *x = layer_input(i, b);
+                    const double *error = errors[i].data() + b * num_nodes;
+                    for (std::size_t n = 0; n < num_nodes; n++)
+                    {
+                        double *gradient = gradients[i].data() + n * (num_weights + 1);
+                        gradient[0] += error[n];
+                        for (std::size_t j = 0; j < num_weights; j++)
+                        {
+                            gradient[j + 1] += error[n] * x[j];
+                        }
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                num_queued++;
+                queued.notify_one();
+            }
+
+            const uint64_t wait_start_ns = Profiler::now_ns();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                reduced.wait(lock, [&]() { return num_reduced == num_queued; });
+            }
+            wait_seconds += (Profiler::now_ns() - wait_start_ns) * 1e-9;
+            if (ret != 0)
+            {
+                break;
+            }
+
+            const double step = learning_rate / count;
+            for (std::size_t i = 0; i < num_layers; i++)
+            {
+                DenseLayer &dense = layer(i);
+                for (std::size_t n = 0; n < dense.num_nodes(); n++)
+                {
+                    const double *gradient = gradients[i].data() + n * (dense.num_weights() + 1);
+                    dense.bias[n] += step * gradient[0];
+                    for (std::size_t j = 0; j < dense.num_weights(); j++)
+                    {
+                        dense.weights[n][j] += step * gradient[j + 1];
+                    }
+                }
+            }
+            first += count;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        queued.notify_one();
+    }
+    communicator.join();
+    if (stats != nullptr)
+    {
+        stats->seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+        stats->communication_seconds = ring.seconds();
+        stats->wait_seconds = wait_seconds;
+        stats->bytes_sent = ring.bytes_sent();
+        stats->samples_per_second = stats->seconds > 0.0 ? num_epochs * this->train_order_.size() / stats->seconds
+                                                          : 0.0;
+    }
+    return ret.load();
+}
+
+/**
+ * @brief trains the network on one sample, e.g. features of a trainable ConvLayer
+ * @details input_error is the error of every input (same sign as the
+ *          DenseLayer errors), calculated with the weights before optimize.
+ *          ConvLayer::backpropagate takes it to train the kernel end to end.
+ *
+ * @param[in] input one value per network input
+ * @param[in] reference one value per network output (target)
+ * @param[in] learning_rate amount of error adjustment used for optimisation
+ * @param[out] input_error one value per network input, or nullptr
+ */
+void NeuralNetwork::train_step(const double *input, const double *reference, const double learning_rate,
+                               double *input_error)
+{
+    const DenseLayer &first = this->hidden_layers_[0];
+    this->feedforward(input, first.num_weights());
+    this->backpropagate(reference);
+    if (input_error != nullptr)
+    {
+        std::fill(input_error, input_error + first.num_weights(), 0.0);
+        for (std::size_t i = 0; i < first.num_nodes(); i++)
+        {
+            Kernels::instance().axpy(input_error, first.error[i], first.weights[i].data(), first.num_weights());
+        }
+    }
+    this->optimize(input, first.num_weights(), learning_rate);
 }
 
 /**
- * @brief initiates the training order vector and sets it to the size of train_x_in 
+ * @brief returns the mean squared error of the network over the training data
+ *
+ * @return double 0 if there is no training data
+ */
+double NeuralNetwork::mean_squared_error(void)
+{
+    return this->evaluate().loss;
+}
+
+/**
+ * @brief evaluates the network on the training data with one forward pass per sample
+ *
+ * @param[in] threshold outputs at or above the threshold count as 1
+ * @return EvaluationResult accuracy, loss, per output errors and samples/s
+ */
+EvaluationResult NeuralNetwork::evaluate(const double threshold)
+{
+    EvaluationResult result(this->output_layer_.num_nodes(), threshold);
+    const uint64_t start_ns = Profiler::now_ns();
+    for (std::size_t i = 0; i < this->train_data_.size(); i++)
+    {
+        this->feedforward(this->train_data_.input(i), this->train_data_.num_inputs());
+        result.add(this->output_layer_.output.data(), this->train_data_.target(i));
+    }
+    result.finish((Profiler::now_ns() - start_ns) * 1e-9);
+    return result;
+}
+
+/**
+ * @brief evaluates the network on a dataset with one batched forward pass,
+ *        e.g. features from the batched ConvLayer::extract_features
+ *
+ * @param[in] inputs one sample per row
+ * @param[in] targets one reference per row, at least one value per output
+ * @param[in] threshold outputs at or above the threshold count as 1
+ * @return EvaluationResult accuracy, loss, per output errors and samples/s,
+ *         empty if the number of rows or targets doesn't match
+ */
+EvaluationResult NeuralNetwork::evaluate(const FeatureMap<double> &inputs,
+                                         const FeatureMap<double> &targets,
+                                         const double threshold)
+{
+    EvaluationResult result(this->output_layer_.num_nodes(), threshold);
+    if (inputs.height() != targets.height() || targets.width() < this->output_layer_.num_nodes())
+    {
+        return result;
+    }
+    FeatureMap<double> outputs;
+    const uint64_t start_ns = Profiler::now_ns();
+    this->predict_batch(inputs, outputs);
+    const double seconds = (Profiler::now_ns() - start_ns) * 1e-9;
+    for (std::size_t i = 0; i < inputs.height(); i++)
+    {
+        result.add(outputs.row(i), targets.row(i));
+    }
+    result.finish(seconds);
+    return result;
+}
+
+/**
+ * @brief returns the bytes allocated by each layer and by the copy of the
+ *        training data (inputs, references and training order)
+ *
+ * @return std::vector<MemoryTracker::Usage> one row per layer and one for the training data
+ */
+std::vector<MemoryTracker::Usage> NeuralNetwork::memory_usage(void) const
+{
+    std::vector<MemoryTracker::Usage> usage;
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const bool hidden = i < this->hidden_layers_.size();
+        usage.push_back((hidden ? this->hidden_layers_[i] : this->output_layer_).memory_usage());
+        usage.back().name = hidden ? "hidden layer " + std::to_string(i + 1) : "output layer";
+    }
+    MemoryTracker::Usage training;
+    training.name = "training data";
+    training.data = this->train_data_.memory_usage() + MemoryTracker::bytes(this->train_order_);
+    usage.push_back(training);
+    return usage;
+}
+
+/**
+ * @brief estimates the memory a network needs before anything is allocated,
+ *        the rows match memory_usage().
+ *
+ * @details batch_size is the number of samples in flight at once. train()
+ *          and train_hogwild() keep one per worker, train_async() and the
+ *          inference server hold batches, which adds two input/reference
+ *          buffers of batch_size samples. The sparse input index is counted
+ *          at its largest size (sparse threshold * inputs).
+ *
+ * @param[in] topology number of inputs, nodes of each hidden layer and number of outputs
+ * @param[in] num_samples number of training samples
+ * @param[in] batch_size number of samples processed at once
+ * @return std::vector<MemoryTracker::Usage> one row per layer, the training data and the batch buffers
+ */
+std::vector<MemoryTracker::Usage> NeuralNetwork::estimate_memory(const std::vector<std::size_t> &topology,
+                                                                 const std::size_t num_samples,
+                                                                 const std::size_t batch_size)
+{
+    std::vector<MemoryTracker::Usage> usage;
+    if (topology.size() < 2)
+    {
+        return usage;
+    }
+    const std::size_t samples_in_flight = batch_size == 0 ? 1 : batch_size;
+    for (std::size_t i = 1; i < topology.size(); i++)
+    {
+        const std::size_t num_nodes = topology[i];
+        const std::size_t num_weights = topology[i - 1];
+        MemoryTracker::Usage layer;
+        layer.name = i + 1 < topology.size() ? "hidden layer " + std::to_string(i) : "output layer";
+        layer.parameters = num_nodes * (sizeof(std::vector<double>) + num_weights * sizeof(double)) +
+                           num_nodes * sizeof(double);
+        layer.activations = samples_in_flight * num_nodes * sizeof(double);
+        layer.errors = samples_in_flight * num_nodes * sizeof(double);
+        layer.data = (std::size_t)(0.5 * num_weights) * sizeof(std::size_t);
+        usage.push_back(layer);
+    }
+
+    const std::size_t num_inputs = topology.front();
+    const std::size_t num_outputs = topology.back();
+    MemoryTracker::Usage training;
+    training.name = "training data";
+    training.data = num_samples * ((num_inputs + num_outputs) * sizeof(double) + sizeof(std::size_t));
+    usage.push_back(training);
+    if (samples_in_flight > 1)
+    {
+        MemoryTracker::Usage batches;
+        batches.name = "batch buffers";
+        batches.data = 2 * samples_in_flight * (num_inputs + num_outputs) * sizeof(double);
+        usage.push_back(batches);
+    }
+    return usage;
+}
+
+/**
+ * @brief checks that a dataset has one input per network input and one
+ *        target per network output
+ *
+ * @param[in] data training samples
+ * @return true if the row sizes match
+ */
+bool NeuralNetwork::matches_training_data(const Dataset &data) const
+{
+    return data.num_inputs() == this->hidden_layers_[0].num_weights() &&
+           data.num_outputs() == this->output_layer_.num_nodes();
+}
+
+/**
+ * @brief initiates the training order vector and sets it to the number of samples
  * 
  */
 void NeuralNetwork::init_training_order(void)
 {
-    this->train_order_.resize(this->train_x_in_.size());
+    this->train_order_.resize(this->train_data_.size());
     for (std::size_t i = 0; i < this->train_order_.size(); i++)
     {
         this->train_order_[i] = i;
@@ -184,18 +1395,31 @@ void NeuralNetwork::init_training_order(void)
  * @param[in] input input signals 
  */
 void NeuralNetwork::feedforward(const std::vector<double> &input)
+{
+    this->feedforward(input.data(), input.size());
+}
+
+/**
+ * @brief calculates output for all nodes from a contiguous input buffer
+ * 
+ * @param[in] input input signals 
+ * @param[in] num_inputs number of values in input
+ */
+void NeuralNetwork::feedforward(const double *input, const std::size_t num_inputs)
 {
     for (size_t i = 0; i < this->hidden_layers_.size(); i++)
     {
+        PROFILE_SCOPE("feedforward", (int)i, this->hidden_layers_[i].flops(), this->hidden_layers_[i].bytes());
         if (i == 0)
         {
-            this->hidden_layers_[i].feedforward(input);
+            this->hidden_layers_[i].feedforward(input, num_inputs);
         }
         else
         {
             this->hidden_layers_[i].feedforward(this->hidden_layers_[i - 1].output);
         }
     }
+    PROFILE_SCOPE("feedforward", (int)this->hidden_layers_.size(), this->output_layer_.flops(), this->output_layer_.bytes());
     this->output_layer_.feedforward(this->hidden_layers_[this->hidden_layers_.size() - 1].output);
 }
 
@@ -207,18 +1431,32 @@ void NeuralNetwork::feedforward(const std::vector<double> &input)
  */
 void NeuralNetwork::backpropagate(const std::vector<double> &reference)
 {
-    this->output_layer_.backpropagate(reference);
+    this->backpropagate(reference.data());
+}
 
-    for (int i = this->hidden_layers_.size() - 1; i >= 0; i--)
+/**
+ * @brief calculates the error for all nodes from a contiguous reference buffer
+ * 
+ * @param[in] reference training data (y_ref, target), one value per output
+ */
+void NeuralNetwork::backpropagate(const double *reference)
+{
     {
+        PROFILE_SCOPE("backpropagate", (int)this->hidden_layers_.size(),
+                      3 * this->output_layer_.num_nodes(), 3 * sizeof(double) * this->output_layer_.num_nodes());
+        this->output_layer_.backpropagate(reference);
+    }
 
+    for (int i = this->hidden_layers_.size() - 1; i >= 0; i--)
+    {
         if (i == (int)this->hidden_layers_.size() - 1)
         {
+            PROFILE_SCOPE("backpropagate", i, this->output_layer_.flops(), this->output_layer_.bytes());
             this->hidden_layers_[i].backpropagate(this->output_layer_);
         }
         else
         {
-
+            PROFILE_SCOPE("backpropagate", i, this->hidden_layers_[i + 1].flops(), this->hidden_layers_[i + 1].bytes());
             this->hidden_layers_[i].backpropagate(this->hidden_layers_[i + 1]);
         }
     }
@@ -232,34 +1470,44 @@ void NeuralNetwork::backpropagate(const std::vector<double> &reference)
  */
 void NeuralNetwork::optimize(const std::vector<double> &input,
                               const double learning_rate)
+{
+    this->optimize(input.data(), input.size(), learning_rate);
+}
+
+/**
+ * @brief calculates new bias and weights for all nodes from a contiguous input buffer
+ * 
+ * @param[in] input training input data
+ * @param[in] num_inputs number of values in input
+ * @param[in] learning_rate amount of error adjustment
+ */
+void NeuralNetwork::optimize(const double *input, const std::size_t num_inputs,
+                              const double learning_rate)
 {
     for (size_t i = 0; i < this->hidden_layers_.size(); i++)
     {
+        PROFILE_SCOPE("optimize", (int)i, 3 * this->hidden_layers_[i].flops() / 2, 2 * this->hidden_layers_[i].bytes());
         if (i == 0)
         {
-            this->hidden_layers_[i].optimize(input, learning_rate);
+            this->hidden_layers_[i].optimize(input, num_inputs, learning_rate);
         }
         else
         {
             this->hidden_layers_[i].optimize(this->hidden_layers_[i - 1].output, learning_rate);
         }
     }
+    PROFILE_SCOPE("optimize", (int)this->hidden_layers_.size(), 3 * this->output_layer_.flops() / 2, 2 * this->output_layer_.bytes());
     this->output_layer_.optimize(this->hidden_layers_[this->hidden_layers_.size() - 1].output, learning_rate);
 }
 
 /**
- * @brief randomizes the training order to prevent overfitting.
+ * @brief randomizes the training order to prevent overfitting,
+ *        Fisher-Yates shuffle with the seeded generator of the network.
  * 
  */
 void NeuralNetwork::randomize_training_order(void)
 {
-    for (std::size_t i = 0; i < this->train_order_.size(); ++i)
-    {
-        const auto r = std::rand() % this->train_order_.size();
-        const auto temp = this->train_order_[i];
-        this->train_order_[i] = this->train_order_[r];
-        this->train_order_[r] = temp;
-    }
+    this->rng_.shuffle(this->train_order_);
 }
 
 /**
@@ -274,8 +1522,7 @@ void NeuralNetwork::clear(void)
     }
     this->hidden_layers_.clear();
     this->output_layer_.clear();
-    this->train_x_in_.clear();
-    this->train_yref_out_.clear();
+    this->train_data_.clear();
     this->train_order_.clear();
 }
 
@@ -291,6 +1538,141 @@ const std::vector<double> &NeuralNetwork::predict(const std::vector<double> &inp
     return this->output_layer_.output;
 }
 
+/**
+ * @brief predicts every row of a batch, e.g. the features from the batched
+ *        ConvLayer::extract_features
+ * @details one batched forward pass: each layer runs over all rows before
+ *          the next layer starts, so its weights are read once per batch
+ *          instead of once per sample. The outputs of a layer are kept as a
+ *          batch x nodes matrix for the next one, the layers are left untouched.
+ *
+ * @param[in] inputs one sample per row, width equal to the number of inputs
+ * @param[out] outputs one prediction per row
+ */
+void NeuralNetwork::predict_batch(const FeatureMap<double> &inputs, FeatureMap<double> &outputs)
+{
+    const std::size_t num_layers = this->hidden_layers_.size() + 1;
+    auto layer = [this](const std::size_t i) -> const DenseLayer &
+    {
+        return i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+    };
+    FeatureMap<double> buffers[2];
+    std::vector<std::size_t> nonzero_index;
+    outputs.resize(inputs.height(), this->output_layer_.num_nodes());
+    for (std::size_t i = 0; i < num_layers; i++)
+    {
+        PROFILE_SCOPE("feedforward", (int)i, layer(i).flops() * inputs.height(), layer(i).bytes());
+        const FeatureMap<double> &in = i == 0 ? inputs : buffers[(i - 1) % 2];
+        FeatureMap<double> &out = i == num_layers - 1 ? outputs : buffers[i % 2];
+        out.resize(inputs.height(), layer(i).num_nodes());
+        for (std::size_t b = 0; b < inputs.height(); b++)
+        {
+            layer(i).feedforward(in.row(b), in.width(), out.row(b), nonzero_index);
+        }
+    }
+}
+
+/**
+ * @brief saves the topology, activations, weights and biases to a text file
+ * @details
+ * NN1
+ * <number of layers, output layer included>
+ * per layer: <num_nodes> <num_weights> <0 = RELU, 1 = TANH>
+ *            <bias per node>
+ *            <weights per node, one node per line>
+ *
+ * @param[in] filename path to the model file
+ * @return int 0 if no errors, 1 if the file can't be written
+ */
+int NeuralNetwork::save(const char *filename) const
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        return 1;
+    }
+    file << "NN1\n" << this->hidden_layers_.size() + 1 << "\n" << std::setprecision(17);
+    for (std::size_t i = 0; i <= this->hidden_layers_.size(); i++)
+    {
+        const DenseLayer &layer = i < this->hidden_layers_.size() ? this->hidden_layers_[i] : this->output_layer_;
+        file << layer.num_nodes() << " " << layer.num_weights() << " "
+             << (layer.ao == activation_option::TANH ? 1 : 0) << "\n";
+        for (const auto bias : layer.bias)
+        {
+            file << bias << " ";
+        }
+        file << "\n";
+        for (const auto &node_weights : layer.weights)
+        {
+            for (const auto weight : node_weights)
+            {
+                file << weight << " ";
+            }
+            file << "\n";
+        }
+    }
+    return file.good() ? 0 : 1;
+}
+
+/**
+ * @brief replaces the network with one saved by save()
+ *
+ * @param[in] filename path to the model file
+ * @return int 0 if no errors, 1 if the file can't be read, 2 if the format is wrong
+ */
+int NeuralNetwork::load(const char *filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        return 1;
+    }
+    std::string magic;
+    std::size_t num_layers = 0;
+    file >> magic >> num_layers;
+    if (magic != "NN1" || num_layers < 2)
+    {
+        return 2;
+    }
+
+    std::vector<DenseLayer> layers(num_layers);
+    for (std::size_t i = 0; i < num_layers; i++)
+    {
+        std::size_t num_nodes = 0;
+        std::size_t num_weights = 0;
+        int tanh_activation = 0;
+        file >> num_nodes >> num_weights >> tanh_activation;
+        if (!file || (i > 0 && num_weights != layers[i - 1].num_nodes()))
+        {
+            return 2;
+        }
+        layers[i].resize(num_nodes, num_weights);
+        layers[i].set_activation(tanh_activation ? activation_option::TANH : activation_option::RELU);
+        for (auto &bias : layers[i].bias)
+        {
+            file >> bias;
+        }
+        for (auto &node_weights : layers[i].weights)
+        {
+            for (auto &weight : node_weights)
+            {
+                file >> weight;
+            }
+        }
+        if (!file)
+        {
+            return 2;
+        }
+    }
+
+    this->clear();
+    this->output_layer_ = layers.back();
+    layers.pop_back();
+    this->hidden_layers_ = layers;
+    this->apply_sparse_threshold();
+    return 0;
+}
+
 /**
  * @brief function to print the results after succesfully training and running the 
 *         neural network
@@ -301,35 +1683,39 @@ const std::vector<double> &NeuralNetwork::predict(const std::vector<double> &inp
 void NeuralNetwork::print_result(const std::size_t num_decimals,
                                   std::ostream &ostream)
 {
-    if (this->train_x_in_.size() == 0)
+    if (this->train_data_.size() == 0)
         return;
     ostream << "-=( training result )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
-    for (size_t i = 0; i < this->train_x_in_.size(); i++)
+    for (size_t i = 0; i < this->train_data_.size(); i++)
     {
+        const double *input = this->train_data_.input(i);
+        const double *target = this->train_data_.target(i);
         ostream << " Input: ";
-        for (size_t j = 0; j < this->train_x_in_[i].size(); j++)
+        for (size_t j = 0; j < this->train_data_.num_inputs(); j++)
         {
-            if(j == 24)
+            if(j > 0 && j % PRINT_VALUES_PER_LINE == 0)
             {
                 ostream << std::endl <<"        ";
             }
-            ostream << this->train_x_in_[i][j] << " ";
+            ostream << input[j] << " ";
         }
         ostream << std::endl << "Target: 0b";
-        for (auto &j : train_yref_out_[i])
+        for (size_t j = 0; j < this->train_data_.num_outputs(); j++)
         {
-            ostream << std::setprecision(num_decimals) << j;
+            ostream << std::setprecision(num_decimals) << target[j];
         }
 
+        this->feedforward(input, this->train_data_.num_inputs());
+        const std::vector<double> &prediction = this->output_layer_.output;
         ostream << std::endl << "  Pred: 0b";
-        for (auto &j : this->predict(this->train_x_in_[i]))
+        for (auto &j : prediction)
         {
             double test = j<0.5? 0 : 1;
             ostream << std::setprecision(num_decimals) << test;
         }
 
         ostream << std::endl << "  Pred: ";
-        for (auto &j : this->predict(this->train_x_in_[i]))
+        for (auto &j : prediction)
         {
             double test = j<0.01? 0.001 : j;
             ostream << std::setprecision(3) << test << "    ";
@@ -2,6 +2,28 @@
 #define NEURALNETWORK_HPP_
 
 #include "denselayer.hpp"
+#include "profiler.hpp"
+#include "featuremap.hpp"
+#include "evaluation.hpp"
+#include "dataset.hpp"
+#include <functional>
+
+#define SHUFFLE_STREAM UINT64_MAX
+#define SNAPSHOT_MAGIC 0x31504e535f4e4eULL
+#define PRINT_VALUES_PER_LINE 24
+
+class Checkpointer;
+class RingAllreduce;
+class TrainingController;
+
+/**
+ * @brief optional preprocessing run by the producer in train_async, writes
+ *        num_features input values for one training sample to features.
+ */
+using preprocess_function = std::function<void(const double *sample,
+                                               const std::size_t num_values,
+                                               double *features,
+                                               const std::size_t num_features)>;
 
 /**
  * @brief Class for neural network.
@@ -17,19 +39,61 @@ class NeuralNetwork
 protected: 
     std::vector<DenseLayer> hidden_layers_;     
     DenseLayer output_layer_;                   
-    std::vector<std::vector<double>> train_x_in_;  
-    std::vector<std::vector<double>> train_yref_out_; 
+    Dataset train_data_;
     std::vector<std::size_t> train_order_;  
+    init_option init_option_ = init_option::UNIFORM;
+    uint64_t seed_ = RNG_DEFAULT_SEED;
+    double sparse_threshold_ = 0.5;
+    Rng rng_;
+
+    void init_layer_weights(const std::size_t first_layer,
+                            const std::size_t num_threads);
+    void apply_sparse_threshold(void);
 
-    void check_training_data_size(void);
+    bool matches_training_data(const Dataset &data) const;
     void init_training_order(void);
     void feedforward(const std::vector<double> &input);
+    void feedforward(const double *input, const std::size_t num_inputs);
     void backpropagate(const std::vector<double> &reference);
+    void backpropagate(const double *reference);
     void optimize(const std::vector<double> &input,
                   const double learning_rate);
+    void optimize(const double *input, const std::size_t num_inputs,
+                  const double learning_rate);
     void randomize_training_order(void);
+    void train_epochs(const std::size_t first_epoch,
+                      const std::size_t num_epochs,
+                      const double learning_rate,
+                      Checkpointer *checkpointer,
+                      TrainingController *controller = nullptr);
 
 public:
+    /**
+     * @brief result of train_batched, activation_bytes counts the outputs,
+     *        checkpoints and errors kept for one batch
+     */
+    struct BatchTrainingStats
+    {
+        std::size_t activation_bytes = 0;
+        std::size_t recomputed_layers = 0;
+        double seconds = 0.0;
+        double samples_per_second = 0.0;
+    };
+
+    /**
+     * @brief result of train_distributed for one worker, wait_seconds is the
+     *        time the worker waited for gradients after its backward pass
+     *        (communication that was not hidden behind computation)
+     */
+    struct DistributedTrainingStats
+    {
+        double seconds = 0.0;
+        double communication_seconds = 0.0;
+        double wait_seconds = 0.0;
+        uint64_t bytes_sent = 0;
+        double samples_per_second = 0.0;
+    };
+
     NeuralNetwork(void) {}
     NeuralNetwork(const std::size_t num_inputs,
                    const std::size_t num_hidden_layers,
@@ -45,12 +109,67 @@ public:
     void add_hidden_layers(std::size_t num_hidden_layers,
                            std::size_t num_hidden_nodes,
                            const activation_option ao = activation_option::TANH);
+    void init_weights(const init_option io = init_option::UNIFORM,
+                      const uint64_t seed = RNG_DEFAULT_SEED,
+                      const std::size_t num_threads = 1);
     void clear(void);
-    void set_training_data(const std::vector<std::vector<double>> &train_in,
-                           const std::vector<std::vector<double>> &train_out);
+    void set_sparse_threshold(const double threshold);
+    std::size_t prune(const double threshold);
+    std::size_t prune_top_k(const double keep_fraction);
+    const std::vector<DenseLayer> &get_hidden_layers(void) const;
+    const DenseLayer &get_output_layer(void) const;
+    int set_training_data(const std::vector<std::vector<double>> &train_in,
+                          const std::vector<std::vector<double>> &train_out);
+    int set_training_data(const Dataset &data);
+    int add_training_sample(const double *input, const double *target);
+    const Dataset &get_training_data(void) const;
     void train(const std::size_t num_epochs,
                const double learning_rate);
+    void train(const std::size_t num_epochs,
+               const double learning_rate,
+               Checkpointer &checkpointer);
+    void train(const std::size_t num_epochs,
+               const double learning_rate,
+               TrainingController &controller);
+    int resume(const char *checkpoint_path,
+               const std::size_t num_epochs,
+               const double learning_rate,
+               Checkpointer *checkpointer = nullptr);
+    std::size_t train_async(const std::size_t num_epochs,
+                            const double learning_rate,
+                            const std::size_t batch_size = 32,
+                            const std::size_t num_buffers = 2,
+                            const preprocess_function &preprocess = nullptr);
+    void train_hogwild(const std::size_t num_epochs,
+                       const double learning_rate,
+                       const std::size_t num_threads);
+    BatchTrainingStats train_batched(const std::size_t num_epochs,
+                                     const double learning_rate,
+                                     const std::size_t batch_size = 32,
+                                     const std::size_t checkpoint_every = 0);
+    int train_distributed(const std::size_t num_epochs,
+                          const double learning_rate,
+                          const std::size_t batch_size,
+                          RingAllreduce &ring,
+                          DistributedTrainingStats *stats = nullptr);
+    void train_step(const double *input, const double *reference, const double learning_rate,
+                    double *input_error = nullptr);
+    double mean_squared_error(void);
+    EvaluationResult evaluate(const double threshold = 0.5);
+    EvaluationResult evaluate(const FeatureMap<double> &inputs,
+                              const FeatureMap<double> &targets,
+                              const double threshold = 0.5);
+    std::vector<MemoryTracker::Usage> memory_usage(void) const;
+    static std::vector<MemoryTracker::Usage> estimate_memory(const std::vector<std::size_t> &topology,
+                                                             const std::size_t num_samples,
+                                                             const std::size_t batch_size = 1);
     const std::vector<double> &predict(const std::vector<double> &input);
+    void predict_batch(const FeatureMap<double> &inputs, FeatureMap<double> &outputs);
+    std::size_t snapshot_size(void) const;
+    void save_snapshot(char *buffer, const std::size_t epoch) const;
+    int load_snapshot(const char *buffer, const std::size_t size, std::size_t &epoch);
+    int save(const char *filename) const;
+    int load(const char *filename);
     void print_result(const std::size_t num_decimals = 1,
                       std::ostream &ostream = std::cout);
     void print_network(print_option po = print_option::LITE, 
@@ -0,0 +1,194 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+/**
+ * @brief returns the profiler shared by the whole program
+ *
+ * @return Profiler&
+ */
+Profiler &Profiler::instance(void)
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+/**
+ * @brief returns a monotonic timestamp in nanoseconds
+ *
+ * @return uint64_t
+ */
+uint64_t Profiler::now_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief adds one call of a region to the statistics and the trace
+ *
+ * @param[in] name region name, must be a string literal
+ * @param[in] layer layer index (-1 if not tied to a layer)
+ * @param[in] start_ns start of the call
+ * @param[in] duration_ns duration of the call
+ * @param[in] flops floating point operations performed by the call
+ * @param[in] bytes bytes read and written by the call
+ */
+void Profiler::record(const char *name, const int layer, const uint64_t start_ns,
+                      const uint64_t duration_ns, const uint64_t flops, const uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    RegionStats *stats = nullptr;
+    for (auto &region : this->regions_)
+    {
+        if (region.layer == layer && (region.name == name || std::strcmp(region.name, name) == 0))
+        {
+            stats = &region;
+            break;
+        }
+    }
+    if (stats == nullptr)
+    {
+        this->regions_.push_back({name, layer, 0, 0, 0, 0});
+        stats = &this->regions_.back();
+    }
+    stats->calls++;
+    stats->total_ns += duration_ns;
+    stats->flops += flops;
+    stats->bytes += bytes;
+
+    if (this->events_.size() < this->max_events_)
+    {
+        this->events_.push_back({name, layer, start_ns, duration_ns});
+    }
+}
+
+/**
+ * @brief adds the summary of one training epoch
+ *
+ * @param[in] epoch epoch number
+ * @param[in] loss mean squared error over the epoch
+ * @param[in] samples number of trained samples
+ * @param[in] seconds wall time of the epoch
+ */
+void Profiler::record_epoch(const std::size_t epoch, const double loss,
+                            const std::size_t samples, const double seconds)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->epochs_.push_back({epoch, loss, samples, seconds});
+}
+
+/**
+ * @brief erases all collected data
+ *
+ */
+void Profiler::reset(void)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->regions_.clear();
+    this->events_.clear();
+    this->epochs_.clear();
+    this->origin_ns_ = now_ns();
+}
+
+/**
+ * @brief sets the max number of trace events kept in memory,
+ *        region statistics are collected regardless.
+ *
+ * @param[in] max_events max number of events
+ */
+void Profiler::set_max_trace_events(const std::size_t max_events)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->max_events_ = max_events;
+}
+
+/**
+ * @brief returns the collected region statistics
+ *
+ * @return const std::vector<RegionStats>&
+ */
+const std::vector<Profiler::RegionStats> &Profiler::regions(void) const
+{
+    return this->regions_;
+}
+
+/**
+ * @brief returns the collected epoch statistics
+ *
+ * @return const std::vector<EpochStats>&
+ */
+const std::vector<Profiler::EpochStats> &Profiler::epochs(void) const
+{
+    return this->epochs_;
+}
+
+/**
+ * @brief prints region and epoch statistics as JSON
+ *
+ * @param[in] ostream chosen output stream
+ */
+void Profiler::print_json(std::ostream &ostream)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto regions = this->regions_;
+    std::sort(regions.begin(), regions.end(), [](const RegionStats &a, const RegionStats &b)
+              { return a.total_ns > b.total_ns; });
+
+    ostream << "{\n  \"regions\": [";
+    for (std::size_t i = 0; i < regions.size(); i++)
+    {
+        const auto &r = regions[i];
+        const double seconds = r.total_ns * 1e-9;
+        ostream << (i == 0 ? "\n" : ",\n");
+        ostream << "    {\"name\": \"" << r.name << "\", \"layer\": " << r.layer
+                << ", \"calls\": " << r.calls
+                << ", \"total_ms\": " << r.total_ns * 1e-6
+                << ", \"avg_us\": " << (r.calls > 0 ? r.total_ns * 1e-3 / r.calls : 0.0)
+                << ", \"flops\": " << r.flops
+                << ", \"bytes\": " << r.bytes
+                << ", \"gflops\": " << (seconds > 0 ? r.flops * 1e-9 / seconds : 0.0)
+                << ", \"gbytes_per_s\": " << (seconds > 0 ? r.bytes * 1e-9 / seconds : 0.0) << "}";
+    }
+    ostream << "\n  ],\n  \"epochs\": [";
+    for (std::size_t i = 0; i < this->epochs_.size(); i++)
+    {
+        const auto &e = this->epochs_[i];
+        ostream << (i == 0 ? "\n" : ",\n");
+        ostream << "    {\"epoch\": " << e.epoch << ", \"loss\": " << e.loss
+                << ", \"samples\": " << e.samples << ", \"seconds\": " << e.seconds
+                << ", \"samples_per_s\": " << (e.seconds > 0 ? e.samples / e.seconds : 0.0) << "}";
+    }
+    ostream << "\n  ]\n}\n";
+}
+
+/**
+ * @brief prints the trace events in the Chrome trace event format,
+ *        load the output in chrome://tracing or ui.perfetto.dev
+ *
+ * @param[in] ostream chosen output stream
+ */
+void Profiler::print_chrome_trace(std::ostream &ostream)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    const auto flags = ostream.flags();
+    const auto precision = ostream.precision();
+    ostream << std::fixed << std::setprecision(3);
+    ostream << "{\"traceEvents\": [";
+    for (std::size_t i = 0; i < this->events_.size(); i++)
+    {
+        const auto &e = this->events_[i];
+        const uint64_t start = e.start_ns > this->origin_ns_ ? e.start_ns - this->origin_ns_ : 0;
+        ostream << (i == 0 ? "\n" : ",\n");
+        ostream << "  {\"name\": \"" << e.name << "\", \"cat\": \"layer " << e.layer
+                << "\", \"ph\": \"X\", \"ts\": " << start * 1e-3
+                << ", \"dur\": " << e.duration_ns * 1e-3
+                << ", \"pid\": 0, \"tid\": " << (e.layer < 0 ? 0 : e.layer)
+                << ", \"args\": {\"layer\": " << e.layer << "}}";
+    }
+    ostream << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    ostream.flags(flags);
+    ostream.precision(precision);
+}
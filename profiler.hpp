@@ -0,0 +1,110 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+
+/**
+ * @brief hooks used by the hot paths in NeuralNetwork and ConvLayer.
+ * @details the hooks expand to nothing unless the program is built with
+ *          -DENABLE_PROFILING (make PROFILE=1), so a normal build pays nothing
+ *          and the flop/byte expressions passed to them are never evaluated.
+ */
+#ifdef ENABLE_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name, layer, flops, bytes) \
+    Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)((name), (layer), (flops), (bytes))
+#define PROFILE_EPOCH(epoch, loss, samples, seconds) \
+    Profiler::instance().record_epoch((epoch), (loss), (samples), (seconds))
+#else
+#define PROFILE_SCOPE(name, layer, flops, bytes) ((void)0)
+#define PROFILE_EPOCH(epoch, loss, samples, seconds) ((void)0)
+#endif
+
+/**
+ * @brief Class for collecting timings of the network and conv-layer hot paths.
+ * @details every region is identified by a name and a layer index and keeps
+ *          call count, wall time, flops and bytes touched. Each call is also
+ *          kept as a trace event (up to a limit) so the run can be viewed in
+ *          chrome://tracing. Training adds one entry per epoch with the loss
+ *          and the number of samples per second.
+ */
+class Profiler
+{
+public:
+    struct RegionStats
+    {
+        const char *name;
+        int layer;
+        std::size_t calls;
+        uint64_t total_ns;
+        uint64_t flops;
+        uint64_t bytes;
+    };
+
+    struct TraceEvent
+    {
+        const char *name;
+        int layer;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    struct EpochStats
+    {
+        std::size_t epoch;
+        double loss;
+        std::size_t samples;
+        double seconds;
+    };
+
+    /**
+     * @brief measures the time between construction and destruction and
+     *        records it to the profiler.
+     */
+    class Scope
+    {
+    public:
+        Scope(const char *name, const int layer, const uint64_t flops, const uint64_t bytes)
+            : name_(name), layer_(layer), flops_(flops), bytes_(bytes), start_ns_(Profiler::now_ns()) {}
+        ~Scope()
+        {
+            Profiler::instance().record(name_, layer_, start_ns_, Profiler::now_ns() - start_ns_, flops_, bytes_);
+        }
+
+    private:
+        const char *name_;
+        int layer_;
+        uint64_t flops_;
+        uint64_t bytes_;
+        uint64_t start_ns_;
+    };
+
+    static Profiler &instance(void);
+    static uint64_t now_ns(void);
+    void record(const char *name, const int layer, const uint64_t start_ns,
+                const uint64_t duration_ns, const uint64_t flops, const uint64_t bytes);
+    void record_epoch(const std::size_t epoch, const double loss,
+                      const std::size_t samples, const double seconds);
+    void reset(void);
+    void set_max_trace_events(const std::size_t max_events);
+    const std::vector<RegionStats> &regions(void) const;
+    const std::vector<EpochStats> &epochs(void) const;
+    void print_json(std::ostream &ostream = std::cout);
+    void print_chrome_trace(std::ostream &ostream = std::cout);
+
+private:
+    Profiler(void) {}
+    std::mutex mutex_;
+    std::vector<RegionStats> regions_;
+    std::vector<TraceEvent> events_;
+    std::vector<EpochStats> epochs_;
+    std::size_t max_events_ = 100000;
+    uint64_t origin_ns_ = now_ns();
+};
+
+#endif /* PROFILER_HPP_ */
@@ -0,0 +1,169 @@
+#include "ringallreduce.hpp"
+#include "profiler.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/**
+ * @brief creates the ring member and makes both sockets non-blocking
+ *
+ * @param[in] rank position of this process in the ring
+ * @param[in] num_ranks number of processes in the ring
+ * @param[in] send_fd socket connected to rank + 1
+ * @param[in] recv_fd socket connected to rank - 1
+ */
+RingAllreduce::RingAllreduce(const std::size_t rank, const std::size_t num_ranks,
+                             const int send_fd, const int recv_fd)
+    : rank_(rank), num_ranks_(num_ranks == 0 ? 1 : num_ranks), send_fd_(send_fd), recv_fd_(recv_fd)
+{
+    for (const int fd : {send_fd, recv_fd})
+    {
+        if (fd >= 0)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+}
+
+/**
+ * @brief replaces values with the element-wise sum of values over all ranks.
+ *        Every rank has to call it with the same size, in the same order.
+ *
+ * @param[in,out] values size values
+ * @param[in] size number of values
+ * @return int 0 if no errors, 1 if a neighbour closed the connection, a socket
+ *         failed or the ring was aborted
+ */
+int RingAllreduce::allreduce(double *values, const std::size_t size)
+{
+    if (this->aborted_)
+    {
+        return 1;
+    }
+    const std::size_t n = this->num_ranks_;
+    if (n == 1 || size == 0)
+    {
+        return 0;
+    }
+    PROFILE_SCOPE("allreduce", -1, size, 2 * size * sizeof(double));
+    const uint64_t start_ns = Profiler::now_ns();
+    auto chunk_begin = [size, n](const std::size_t chunk)
+    {
+        return size * (chunk % n) / n;
+    };
+    auto chunk_size = [size, n](const std::size_t chunk)
+    {
+        return size * (chunk % n + 1) / n - size * (chunk % n) / n;
+    };
+    this->buffer_.resize(size / n + 1);
+
+    // step s: send chunk rank - s, receive chunk rank - s - 1 (mod n) and add it
+    for (std::size_t s = 0; s + 1 < n; s++)
+    {
+        const std::size_t send_chunk = this->rank_ + n - s;
+        const std::size_t recv_chunk = this->rank_ + 2 * n - s - 1;
+        if (this->exchange(values + chunk_begin(send_chunk), chunk_size(send_chunk),
+                           this->buffer_.data(), chunk_size(recv_chunk)) != 0)
+        {
+            return 1;
+        }
+        double *sum = values + chunk_begin(recv_chunk);
+        for (std::size_t i = 0; i < chunk_size(recv_chunk); i++)
+        {
+            sum[i] += this->buffer_[i];
+        }
+    }
+    // rank now owns the sum of chunk rank + 1, pass the sums on around the ring
+    for (std::size_t s = 0; s + 1 < n; s++)
+    {
+        const std::size_t send_chunk = this->rank_ + 1 + n - s;
+        const std::size_t recv_chunk = this->rank_ + 2 * n - s;
+        if (this->exchange(values + chunk_begin(send_chunk), chunk_size(send_chunk),
+                           values + chunk_begin(recv_chunk), chunk_size(recv_chunk)) != 0)
+        {
+            return 1;
+        }
+    }
+    this->seconds_ += (Profiler::now_ns() - start_ns) * 1e-9;
+    return 0;
+}
+
+/**
+ * @brief shuts both sockets down so the neighbours see the connection close
+ *        and fail in their allreduce. The sockets stay open for the owner to
+ *        close, every later allreduce returns 1.
+ *
+ */
+void RingAllreduce::abort(void)
+{
+    this->aborted_ = true;
+    for (const int fd : {this->send_fd_, this->recv_fd_})
+    {
+        if (fd >= 0)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+}
+
+/**
+ * @brief sends num_send values to the next rank while receiving num_receive
+ *        values from the previous rank
+ *
+ * @param[in] send values for the next rank
+ * @param[in] num_send number of values to send
+ * @param[out] receive buffer for the values of the previous rank
+ * @param[in] num_receive number of values to receive
+ * @return int 0 if no errors, 1 if a socket failed or was closed
+ */
+int RingAllreduce::exchange(const double *send, const std::size_t num_send,
+                            double *receive, const std::size_t num_receive)
+{
+    const char *out = (const char *)send;
+    char *in = (char *)receive;
+    std::size_t num_out = num_send * sizeof(double);
+    std::size_t num_in = num_receive * sizeof(double);
+    while (num_out > 0 || num_in > 0)
+    {
+        pollfd fds[2] = {{this->send_fd_, (short)(num_out > 0 ? POLLOUT : 0), 0},
+                         {this->recv_fd_, (short)(num_in > 0 ? POLLIN : 0), 0}};
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 1;
+        }
+        if (num_out > 0 && (fds[0].revents & (POLLOUT | POLLERR | POLLHUP)) != 0)
+        {
+            const ssize_t n = ::send(this->send_fd_, out, num_out, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                return 1;
+            }
+            if (n > 0)
+            {
+                out += n;
+                num_out -= n;
+                this->bytes_sent_ += n;
+            }
+        }
+        if (num_in > 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP)) != 0)
+        {
+            const ssize_t n = ::recv(this->recv_fd_, in, num_in, 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                return 1;
+            }
+            if (n > 0)
+            {
+                in += n;
+                num_in -= n;
+            }
+        }
+    }
+    return 0;
+}
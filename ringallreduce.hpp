@@ -0,0 +1,58 @@
+#ifndef RINGALLREDUCE_HPP_
+#define RINGALLREDUCE_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Class for summing a buffer of doubles over the processes of a ring.
+ * @details every rank is connected to the next rank by send_fd and to the
+ *          previous rank by recv_fd, both connected stream sockets (Unix
+ *          domain sockets from socketpair, or TCP connections between hosts).
+ *          The buffer is split into num_ranks chunks. In num_ranks - 1
+ *          reduce-scatter steps every rank sends one chunk to the next rank and
+ *          adds the chunk it receives, after which every rank owns the full
+ *          sum of one chunk. In num_ranks - 1 all-gather steps the summed
+ *          chunks travel around the ring. Every rank sends and receives
+ *          2 * (num_ranks - 1) / num_ranks of the buffer, whatever the number
+ *          of ranks, and ends with bit-identical sums.
+ *
+ *          Sending and receiving are interleaved with poll on non-blocking
+ *          sockets, so chunks larger than the socket buffers cannot deadlock.
+ *          A rank that gives up calls abort, its neighbours then fail in
+ *          their allreduce instead of waiting for it, and so on around the ring.
+ *
+ * @param[in] rank position of this process in the ring (0 .. num_ranks - 1)
+ * @param[in] num_ranks number of processes in the ring
+ * @param[in] send_fd socket connected to rank + 1
+ * @param[in] recv_fd socket connected to rank - 1
+ */
+class RingAllreduce
+{
+public:
+    RingAllreduce(const std::size_t rank, const std::size_t num_ranks,
+                  const int send_fd, const int recv_fd);
+    ~RingAllreduce() {}
+    int allreduce(double *values, const std::size_t size);
+    void abort(void);
+    std::size_t rank(void) const { return this->rank_; }
+    std::size_t num_ranks(void) const { return this->num_ranks_; }
+    uint64_t bytes_sent(void) const { return this->bytes_sent_; }
+    double seconds(void) const { return this->seconds_; }
+
+private:
+    std::size_t rank_;
+    std::size_t num_ranks_;
+    int send_fd_;
+    int recv_fd_;
+    bool aborted_ = false;
+    std::vector<double> buffer_;
+    uint64_t bytes_sent_ = 0;
+    double seconds_ = 0.0;
+
+    int exchange(const double *send, const std::size_t num_send,
+                 double *receive, const std::size_t num_receive);
+};
+
+#endif /* RINGALLREDUCE_HPP_ */
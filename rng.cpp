@@ -0,0 +1,176 @@
+#include "rng.hpp"
+#include <atomic>
+
+static std::atomic<uint64_t> thread_seed(RNG_DEFAULT_SEED);
+static std::atomic<uint64_t> thread_counter(0);
+
+/**
+ * @brief Construct a new Rng::Rng object
+ *
+ * @param[in] seed seed shared by all streams of one run
+ * @param[in] stream stream number
+ */
+Rng::Rng(const uint64_t seed, const uint64_t stream)
+{
+    this->seed(seed, stream);
+}
+
+/**
+ * @brief restarts the generator at the beginning of a stream
+ *
+ * @param[in] seed seed shared by all streams of one run
+ * @param[in] stream stream number
+ */
+void Rng::seed(const uint64_t seed, const uint64_t stream)
+{
+    uint64_t x = stream;
+    uint64_t mixed = seed ^ splitmix64(x);
+    for (auto &word : this->state_)
+    {
+        word = splitmix64(mixed);
+    }
+}
+
+/**
+ * @brief returns the next 64 random bits
+ *
+ * @return uint64_t
+ */
+uint64_t Rng::next(void)
+{
+    auto rotl = [](const uint64_t x, const int k)
+    { return (x << k) | (x >> (64 - k)); };
+
+    const uint64_t result = rotl(this->state_[1] * 5, 7) * 9;
+    const uint64_t t = this->state_[1] << 17;
+    this->state_[2] ^= this->state_[0];
+    this->state_[3] ^= this->state_[1];
+    this->state_[1] ^= this->state_[2];
+    this->state_[0] ^= this->state_[3];
+    this->state_[2] ^= t;
+    this->state_[3] = rotl(this->state_[3], 45);
+    return result;
+}
+
+/**
+ * @brief returns a value in [0, 1) with 53 random bits
+ *
+ * @return double
+ */
+double Rng::uniform(void)
+{
+    return (this->next() >> 11) * 0x1.0p-53;
+}
+
+/**
+ * @brief returns a value in [min, max)
+ *
+ * @param[in] min lower bound
+ * @param[in] max upper bound
+ * @return double
+ */
+double Rng::uniform(const double min, const double max)
+{
+    return min + (max - min) * this->uniform();
+}
+
+/**
+ * @brief returns an integer in [0, range) without modulo bias (Lemire's method)
+ *
+ * @param[in] range number of possible values
+ * @return std::size_t 0 if range is 0
+ */
+std::size_t Rng::bounded(const std::size_t range)
+{
+    if (range == 0)
+    {
+        return 0;
+    }
+    const uint64_t n = range;
+    __uint128_t product = (__uint128_t)this->next() * n;
+    uint64_t low = (uint64_t)product;
+    if (low < n)
+    {
+        const uint64_t threshold = (0 - n) % n;
+        while (low < threshold)
+        {
+            product = (__uint128_t)this->next() * n;
+            low = (uint64_t)product;
+        }
+    }
+    return (std::size_t)(product >> 64);
+}
+
+/**
+ * @brief shuffles the values in O(n) with Fisher-Yates, every order is equally likely
+ *
+ * @param[in,out] values values to shuffle
+ */
+void Rng::shuffle(std::vector<std::size_t> &values)
+{
+    for (std::size_t i = values.size(); i > 1; i--)
+    {
+        const std::size_t j = this->bounded(i);
+        const auto temp = values[i - 1];
+        values[i - 1] = values[j];
+        values[j] = temp;
+    }
+}
+
+/**
+ * @brief returns the state, used to save and restore the generator
+ *
+ * @return std::array<uint64_t, 4>
+ */
+std::array<uint64_t, 4> Rng::get_state(void) const
+{
+    return this->state_;
+}
+
+/**
+ * @brief restores a state from get_state
+ *
+ * @param[in] state state to restore
+ */
+void Rng::set_state(const std::array<uint64_t, 4> &state)
+{
+    this->state_ = state;
+}
+
+/**
+ * @brief returns the generator of the calling thread.
+ * @details created on first use from the thread seed and the order in which
+ *          threads first use it, so use an explicitly seeded Rng when the
+ *          result must not depend on the number of threads.
+ *
+ * @return Rng&
+ */
+Rng &Rng::thread_instance(void)
+{
+    thread_local Rng rng(thread_seed.load(), thread_counter.fetch_add(1));
+    return rng;
+}
+
+/**
+ * @brief sets the seed used by threads that have not yet called thread_instance
+ *
+ * @param[in] seed seed
+ */
+void Rng::set_thread_seed(const uint64_t seed)
+{
+    thread_seed = seed;
+}
+
+/**
+ * @brief splitmix64, used to expand the seed into the xoshiro state
+ *
+ * @param[in,out] x splitmix state
+ * @return uint64_t
+ */
+uint64_t Rng::splitmix64(uint64_t &x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
@@ -0,0 +1,43 @@
+#ifndef RNG_HPP_
+#define RNG_HPP_
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+#define RNG_DEFAULT_SEED 0x853c49e6748fea9bULL
+
+/**
+ * @brief Class for a fast, seedable random number generator (xoshiro256**).
+ * @details every generator is created from a seed and a stream number. The
+ *          state is derived from both with splitmix64, so two streams of the
+ *          same seed are independent. Giving every unit of work its own
+ *          stream (e.g. one per layer and node) makes the result the same no
+ *          matter how the work is split between threads.
+ *
+ * @param[in] seed seed shared by all streams of one run
+ * @param[in] stream stream number
+ */
+class Rng
+{
+public:
+    Rng(const uint64_t seed = RNG_DEFAULT_SEED, const uint64_t stream = 0);
+    ~Rng() {}
+    void seed(const uint64_t seed, const uint64_t stream = 0);
+    uint64_t next(void);
+    double uniform(void);
+    double uniform(const double min, const double max);
+    std::size_t bounded(const std::size_t range);
+    void shuffle(std::vector<std::size_t> &values);
+    std::array<uint64_t, 4> get_state(void) const;
+    void set_state(const std::array<uint64_t, 4> &state);
+    static Rng &thread_instance(void);
+    static void set_thread_seed(const uint64_t seed);
+
+private:
+    std::array<uint64_t, 4> state_;
+    static uint64_t splitmix64(uint64_t &x);
+};
+
+#endif /* RNG_HPP_ */
@@ -0,0 +1,187 @@
+#include "sparselayer.hpp"
+
+/**
+ * @brief Construct a new SparseLayer::SparseLayer object from a (pruned) dense layer
+ *
+ * @param[in] layer trained dense layer
+ * @param[in] max_density highest fraction of non-zero weights stored as CSR
+ */
+SparseLayer::SparseLayer(const DenseLayer &layer, const double max_density)
+{
+    this->init(layer, max_density);
+}
+
+/**
+ * @brief copies the weights, bias and activation of a dense layer.
+ *
+ * @details the non-zero weights are counted first. If their share is above
+ *          max_density the CSR index overhead (4 bytes per weight) and the
+ *          indirect input access cost more than the skipped multiplications,
+ *          so the layer falls back to a dense row-major matrix.
+ * @param[in] layer trained dense layer
+ * @param[in] max_density highest fraction of non-zero weights stored as CSR
+ */
+void SparseLayer::init(const DenseLayer &layer, const double max_density)
+{
+    this->ao = layer.ao;
+    this->num_inputs = layer.num_weights();
+    this->bias = layer.bias;
+    this->output.assign(layer.num_nodes(), 0.0);
+    this->values.clear();
+    this->col_index.clear();
+    this->row_ptr.clear();
+    this->dense_weights.clear();
+
+    this->nonzero = 0;
+    for (const auto &node_weights : layer.weights)
+    {
+        for (const auto weight : node_weights)
+        {
+            this->nonzero += weight != 0.0 ? 1 : 0;
+        }
+    }
+    this->sparse = this->density() <= max_density;
+
+    if (this->sparse)
+    {
+        this->values.reserve(this->nonzero);
+        this->col_index.reserve(this->nonzero);
+        this->row_ptr.reserve(layer.num_nodes() + 1);
+        this->row_ptr.push_back(0);
+        for (const auto &node_weights : layer.weights)
+        {
+            for (std::size_t j = 0; j < node_weights.size(); j++)
+            {
+                if (node_weights[j] != 0.0)
+                {
+                    this->values.push_back(node_weights[j]);
+                    this->col_index.push_back((uint32_t)j);
+                }
+            }
+            this->row_ptr.push_back((uint32_t)this->values.size());
+        }
+    }
+    else
+    {
+        this->dense_weights.reserve(layer.num_nodes() * this->num_inputs);
+        for (const auto &node_weights : layer.weights)
+        {
+            this->dense_weights.insert(this->dense_weights.end(), node_weights.begin(), node_weights.end());
+        }
+    }
+}
+
+/**
+ * @brief calculates new output for each node with the sparse matrix-vector
+ *        kernel, or the dense kernel if the layer fell back to dense storage.
+ *
+ * @param[in] input indata from the previous layer, at least num_weights() values
+ */
+void SparseLayer::feedforward(const std::vector<double> &input)
+{
+    if (this->sparse)
+    {
+        for (std::size_t i = 0; i < this->output.size(); i++)
+        {
+            double sum = this->bias[i];
+            for (uint32_t k = this->row_ptr[i]; k < this->row_ptr[i + 1]; k++)
+            {
+                sum += this->values[k] * input[this->col_index[k]];
+            }
+            this->output[i] = this->activation(sum);
+        }
+    }
+    else
+    {
+        const double *row = this->dense_weights.data();
+        for (std::size_t i = 0; i < this->output.size(); i++, row += this->num_inputs)
+        {
+            double sum = this->bias[i];
+            for (std::size_t j = 0; j < this->num_inputs; j++)
+            {
+                sum += row[j] * input[j];
+            }
+            this->output[i] = this->activation(sum);
+        }
+    }
+}
+
+/**
+ * @brief returns the number of nodes
+ *
+ * @return number of nodes.
+ */
+std::size_t SparseLayer::num_nodes(void) const
+{
+    return this->output.size();
+}
+
+/**
+ * @brief returns the number of weights per node (inputs), zeros included
+ *
+ * @return number of weights.
+ */
+std::size_t SparseLayer::num_weights(void) const
+{
+    return this->num_inputs;
+}
+
+/**
+ * @brief returns the number of non-zero weights
+ *
+ * @return number of non-zero weights.
+ */
+std::size_t SparseLayer::num_nonzero(void) const
+{
+    return this->nonzero;
+}
+
+/**
+ * @brief returns the fraction of non-zero weights
+ *
+ * @return double 0.0 - 1.0
+ */
+double SparseLayer::density(void) const
+{
+    const std::size_t total = this->num_nodes() * this->num_weights();
+    return total > 0 ? (double)this->nonzero / total : 0.0;
+}
+
+/**
+ * @brief returns true if the weights are stored as CSR
+ *
+ * @return bool
+ */
+bool SparseLayer::is_sparse(void) const
+{
+    return this->sparse;
+}
+
+/**
+ * @brief returns the number of bytes used by weights, indices, bias and output
+ *
+ * @return number of bytes.
+ */
+std::size_t SparseLayer::memory_usage(void) const
+{
+    return sizeof(double) * (this->values.size() + this->dense_weights.size() + this->bias.size() + this->output.size()) +
+           sizeof(uint32_t) * (this->col_index.size() + this->row_ptr.size());
+}
+
+/**
+ * @brief same activation as DenseLayer::activation
+ *
+ * @param[in] sum
+ * @return sum
+ */
+inline double SparseLayer::activation(const double sum)
+{
+    if (this->ao == activation_option::TANH)
+    {
+        return tanh(sum);
+    }
+    else
+    {
+        return sum > 0.0 ? sum : 0.0;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SPARSELAYER_HPP_
+#define SPARSELAYER_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <math.h>
+
+#include "denselayer.hpp"
+
+/**
+ * @brief Class for a pruned dense layer used for inference.
+ * @details the weights are stored in compressed sparse row (CSR) format,
+ *          row i holds the non-zero weights of node i:
+ *          values[row_ptr[i] .. row_ptr[i+1]] with the input index in col_index.
+ *          If the layer is too dense for CSR to pay off the weights are
+ *          kept as a flat row-major matrix and the dense kernel is used.
+ */
+class SparseLayer
+{
+public:
+    std::vector<double> output;
+    SparseLayer(void) {}
+    SparseLayer(const DenseLayer &layer, const double max_density = 0.5);
+    ~SparseLayer() {}
+    void init(const DenseLayer &layer, const double max_density = 0.5);
+    void feedforward(const std::vector<double> &input);
+    std::size_t num_nodes(void) const;
+    std::size_t num_weights(void) const;
+    std::size_t num_nonzero(void) const;
+    double density(void) const;
+    bool is_sparse(void) const;
+    std::size_t memory_usage(void) const;
+
+private:
+    activation_option ao = activation_option::TANH;
+    std::size_t num_inputs = 0;
+    std::size_t nonzero = 0;
+    bool sparse = false;
+    std::vector<double> bias;
+    std::vector<double> values;
+    std::vector<uint32_t> col_index;
+    std::vector<uint32_t> row_ptr;
+    std::vector<double> dense_weights;
+    inline double activation(const double sum);
+};
+
+#endif /* SPARSELAYER_HPP_ */
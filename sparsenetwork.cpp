@@ -0,0 +1,173 @@
+#include "sparsenetwork.hpp"
+#include <chrono>
+#include <iomanip>
+
+/**
+ * @brief Construct a new SparseNetwork::SparseNetwork object
+ *
+ * @param[in] network trained neural network
+ * @param[in] max_density highest fraction of non-zero weights stored as CSR
+ */
+SparseNetwork::SparseNetwork(const NeuralNetwork &network, const double max_density)
+{
+    this->init(network, max_density);
+}
+
+/**
+ * @brief converts every layer of the network, hidden layers first
+ *
+ * @param[in] network trained neural network
+ * @param[in] max_density highest fraction of non-zero weights stored as CSR
+ */
+void SparseNetwork::init(const NeuralNetwork &network, const double max_density)
+{
+    this->layers_.clear();
+    for (const auto &layer : network.get_hidden_layers())
+    {
+        this->layers_.emplace_back(layer, max_density);
+    }
+    this->layers_.emplace_back(network.get_output_layer(), max_density);
+}
+
+/**
+ * @brief runs inputs signals through the network and returns the answer
+ *
+ * @param[in] input input signals
+ * @return const std::vector<double>&
+ */
+const std::vector<double> &SparseNetwork::predict(const std::vector<double> &input)
+{
+    for (std::size_t i = 0; i < this->layers_.size(); i++)
+    {
+        this->layers_[i].feedforward(i == 0 ? input : this->layers_[i - 1].output);
+    }
+    return this->layers_.back().output;
+}
+
+/**
+ * @brief returns the number of bytes used by all layers
+ *
+ * @return number of bytes.
+ */
+std::size_t SparseNetwork::memory_usage(void) const
+{
+    std::size_t bytes = 0;
+    for (const auto &layer : this->layers_)
+    {
+        bytes += layer.memory_usage();
+    }
+    return bytes;
+}
+
+/**
+ * @brief returns the fraction of non-zero weights in the network
+ *
+ * @return double 0.0 - 1.0
+ */
+double SparseNetwork::density(void) const
+{
+    std::size_t total = 0;
+    std::size_t nonzero = 0;
+    for (const auto &layer : this->layers_)
+    {
+        total += layer.num_nodes() * layer.num_weights();
+        nonzero += layer.num_nonzero();
+    }
+    return total > 0 ? (double)nonzero / total : 0.0;
+}
+
+/**
+ * @brief prints storage format, density and size of every layer
+ *
+ * @param[in] ostream chosen output stream
+ */
+void SparseNetwork::print(std::ostream &ostream)
+{
+    for (std::size_t i = 0; i < this->layers_.size(); i++)
+    {
+        const auto &layer = this->layers_[i];
+        ostream << (i + 1 < this->layers_.size() ? "hidden layer " : "output layer ") << i + 1 << ": "
+                << layer.num_nodes() << "x" << layer.num_weights() << " "
+                << (layer.is_sparse() ? "CSR" : "dense") << ", density " << layer.density()
+                << ", " << layer.memory_usage() << " bytes\n";
+    }
+}
+
+/**
+ * @brief prunes copies of the network to several sparsity levels and prints
+ *        memory footprint, latency and output deviation for each level.
+ *
+ * @details every level keeps the largest (1 - sparsity) fraction of the weights
+ *          per layer (NeuralNetwork::prune_top_k). Latency is the mean time of
+ *          one predict over the given inputs for the dense network and the
+ *          pruned sparse network. The deviation is the largest output
+ *          difference against the unpruned network.
+ * @param[in] network trained neural network
+ * @param[in] inputs input signals used for timing
+ * @param[in] sparsity_levels fractions of the weights to remove
+ * @param[in] ostream chosen output stream
+ */
+void SparseNetwork::print_pruning_report(const NeuralNetwork &network,
+                                         const std::vector<std::vector<double>> &inputs,
+                                         const std::vector<double> &sparsity_levels,
+                                         std::ostream &ostream)
+{
+    if (inputs.size() == 0)
+        return;
+    const std::size_t repeats = std::max<std::size_t>(1, 2000 / inputs.size());
+    NeuralNetwork reference = network;
+
+    std::size_t dense_bytes = 0;
+    for (const auto &layer : network.get_hidden_layers())
+    {
+        dense_bytes += sizeof(double) * layer.num_nodes() * (layer.num_weights() + 2);
+    }
+    dense_bytes += sizeof(double) * network.get_output_layer().num_nodes() * (network.get_output_layer().num_weights() + 2);
+
+    auto time_us = [&](auto &&predict)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t r = 0; r < repeats; r++)
+        {
+            for (const auto &input : inputs)
+            {
+                predict(input);
+            }
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / (repeats * inputs.size());
+    };
+
+    ostream << "-=( pruning report )=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n";
+    ostream << "sparsity  density  dense bytes  sparse bytes  dense us  sparse us  max deviation\n";
+    for (const auto level : sparsity_levels)
+    {
+        NeuralNetwork pruned = network;
+        pruned.prune_top_k(1.0 - level);
+        SparseNetwork sparse(pruned);
+
+        double deviation = 0.0;
+        for (const auto &input : inputs)
+        {
+            const auto expected = reference.predict(input);
+            const auto &actual = sparse.predict(input);
+            for (std::size_t i = 0; i < actual.size(); i++)
+            {
+                deviation = std::max(deviation, fabs(expected[i] - actual[i]));
+            }
+        }
+        const double dense_us = time_us([&](const std::vector<double> &input)
+                                        { pruned.predict(input); });
+        const double sparse_us = time_us([&](const std::vector<double> &input)
+                                         { sparse.predict(input); });
+
+        ostream << std::setfill(' ') << std::fixed << std::setprecision(2)
+                << std::setw(8) << level << std::setw(9) << sparse.density()
+                << std::setw(13) << dense_bytes << std::setw(14) << sparse.memory_usage()
+                << std::setw(10) << dense_us << std::setw(11) << sparse_us
+                << std::setw(15) << std::setprecision(4) << deviation << "\n";
+        ostream.unsetf(std::ios_base::floatfield);
+    }
+    ostream << std::setprecision(6);
+    ostream << "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-\n\n";
+}
@@ -0,0 +1,38 @@
+#ifndef SPARSENETWORK_HPP_
+#define SPARSENETWORK_HPP_
+
+#include <vector>
+#include <iostream>
+
+#include "neuralnetwork.hpp"
+#include "sparselayer.hpp"
+
+/**
+ * @brief Class for inference with a pruned neural network.
+ * @details built from a trained (and pruned) NeuralNetwork, every layer is
+ *          stored as CSR or, when it is too dense, as a flat dense matrix.
+ *
+ * @param[in] network trained neural network
+ * @param[in] max_density highest fraction of non-zero weights stored as CSR
+ */
+class SparseNetwork
+{
+public:
+    SparseNetwork(void) {}
+    SparseNetwork(const NeuralNetwork &network, const double max_density = 0.5);
+    ~SparseNetwork() {}
+    void init(const NeuralNetwork &network, const double max_density = 0.5);
+    const std::vector<double> &predict(const std::vector<double> &input);
+    std::size_t memory_usage(void) const;
+    double density(void) const;
+    void print(std::ostream &ostream = std::cout);
+    static void print_pruning_report(const NeuralNetwork &network,
+                                     const std::vector<std::vector<double>> &inputs,
+                                     const std::vector<double> &sparsity_levels = {0.0, 0.5, 0.75, 0.9, 0.95},
+                                     std::ostream &ostream = std::cout);
+
+private:
+    std::vector<SparseLayer> layers_;
+};
+
+#endif /* SPARSENETWORK_HPP_ */
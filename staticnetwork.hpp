@@ -0,0 +1,207 @@
+#ifndef STATICNETWORK_HPP_
+#define STATICNETWORK_HPP_
+
+#include <array>
+#include <cstddef>
+#include <math.h>
+
+#include "neuralnetwork.hpp"
+
+/**
+ * @brief one dense layer with its size fixed at compile time, used by StaticNetwork.
+ *
+ * @param[in] In number of inputs (weights per node)
+ * @param[in] Out number of nodes
+ */
+template <std::size_t In, std::size_t Out>
+class StaticLayer
+{
+public:
+    std::array<double, Out> output{};
+    std::array<double, Out> bias{};
+    std::array<std::array<double, In>, Out> weights{};
+    activation_option ao = activation_option::TANH;
+
+    /**
+     * @brief copies bias, weights and activation from a trained layer
+     *
+     * @param[in] layer layer with Out nodes and In weights per node
+     * @return int 0 if no errors, 1 if the size doesn't match
+     */
+    int load(const DenseLayer &layer)
+    {
+        if (layer.num_nodes() != Out || layer.num_weights() != In)
+        {
+            return 1;
+        }
+        for (std::size_t i = 0; i < Out; i++)
+        {
+            this->bias[i] = layer.bias[i];
+            for (std::size_t j = 0; j < In; j++)
+            {
+                this->weights[i][j] = layer.weights[i][j];
+            }
+        }
+        this->ao = layer.ao;
+        return 0;
+    }
+
+    /**
+     * @brief same sums in index order as the scalar kernels of
+     *        DenseLayer::feedforward, so the outputs are identical with
+     *        NN_ISA=scalar and equal up to rounding with the vector kernels.
+     *        The bounds are constants the compiler can unroll, the activation
+     *        is chosen once per layer instead of per node.
+     *
+     * @param[in] input In values
+     */
+    void feedforward(const double *input)
+    {
+        for (std::size_t i = 0; i < Out; i++)
+        {
+            double sum = this->bias[i];
+            for (std::size_t j = 0; j < In; j++)
+            {
+                sum += input[j] * this->weights[i][j];
+            }
+            this->output[i] = sum;
+        }
+        if (this->ao == activation_option::TANH)
+        {
+            for (std::size_t i = 0; i < Out; i++)
+            {
+                this->output[i] = tanh(this->output[i]);
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i < Out; i++)
+            {
+                this->output[i] = this->output[i] > 0.0 ? this->output[i] : 0.0;
+            }
+        }
+    }
+};
+
+/**
+ * @brief the layers of a StaticNetwork, the first layer followed by the rest.
+ */
+template <std::size_t In, std::size_t Out, std::size_t... Rest>
+class StaticLayers
+{
+public:
+    static constexpr std::size_t num_outputs = StaticLayers<Out, Rest...>::num_outputs;
+    static constexpr std::size_t num_layers = StaticLayers<Out, Rest...>::num_layers + 1;
+
+    StaticLayer<In, Out> layer;
+    StaticLayers<Out, Rest...> next;
+
+    int load(const NeuralNetwork &network, const std::size_t index)
+    {
+        return this->layer.load(layer_of(network, index)) != 0 ? 1 : this->next.load(network, index + 1);
+    }
+
+    const std::array<double, num_outputs> &feedforward(const double *input)
+    {
+        this->layer.feedforward(input);
+        return this->next.feedforward(this->layer.output.data());
+    }
+
+    /**
+     * @brief returns hidden layer index, or the output layer after the hidden layers
+     */
+    static const DenseLayer &layer_of(const NeuralNetwork &network, const std::size_t index)
+    {
+        return index < network.get_hidden_layers().size() ? network.get_hidden_layers()[index]
+                                                          : network.get_output_layer();
+    }
+};
+
+template <std::size_t In, std::size_t Out>
+class StaticLayers<In, Out>
+{
+public:
+    static constexpr std::size_t num_outputs = Out;
+    static constexpr std::size_t num_layers = 1;
+
+    StaticLayer<In, Out> layer;
+
+    int load(const NeuralNetwork &network, const std::size_t index)
+    {
+        if (index != network.get_hidden_layers().size())
+        {
+            return 1;
+        }
+        return this->layer.load(network.get_output_layer());
+    }
+
+    const std::array<double, Out> &feedforward(const double *input)
+    {
+        this->layer.feedforward(input);
+        return this->layer.output;
+    }
+};
+
+/**
+ * @brief Class for inference with a topology fixed at compile time.
+ * @details weights, biases and outputs of every layer are stored in
+ *          std::array inside the object, so a StaticNetwork on the stack (or
+ *          in static storage) predicts without any heap allocation and with
+ *          the same amount of work every call. The weights are copied from a
+ *          trained NeuralNetwork with the same topology, the predictions equal
+ *          NeuralNetwork::predict up to the rounding of its vector kernels.
+ *
+ *          StaticNetwork<49, 49, 10, 10, 10, 4> has 49 inputs, hidden layers
+ *          of 49, 10, 10 and 10 nodes and 4 outputs, the network of the demo.
+ *
+ * @param[in] In number of inputs
+ * @param[in] Sizes number of nodes per hidden layer followed by the number of outputs
+ */
+template <std::size_t In, std::size_t... Sizes>
+class StaticNetwork
+{
+public:
+    static_assert(sizeof...(Sizes) >= 2, "StaticNetwork needs at least one hidden layer and an output layer");
+    static constexpr std::size_t num_inputs = In;
+    static constexpr std::size_t num_outputs = StaticLayers<In, Sizes...>::num_outputs;
+    static constexpr std::size_t num_layers = StaticLayers<In, Sizes...>::num_layers;
+
+    StaticNetwork(void) {}
+    ~StaticNetwork() {}
+
+    /**
+     * @brief copies the weights of a trained network
+     *
+     * @param[in] network trained network with the same topology
+     * @return int 0 if no errors, 1 if the topology doesn't match
+     */
+    int load(const NeuralNetwork &network)
+    {
+        if (network.get_hidden_layers().size() + 1 != num_layers)
+        {
+            return 1;
+        }
+        return this->layers_.load(network, 0);
+    }
+
+    /**
+     * @brief runs the network, the result is valid until the next predict
+     *
+     * @param[in] input In values
+     * @return const std::array<double, num_outputs>&
+     */
+    const std::array<double, num_outputs> &predict(const double *input)
+    {
+        return this->layers_.feedforward(input);
+    }
+
+    const std::array<double, num_outputs> &predict(const std::array<double, In> &input)
+    {
+        return this->layers_.feedforward(input.data());
+    }
+
+private:
+    StaticLayers<In, Sizes...> layers_;
+};
+
+#endif /* STATICNETWORK_HPP_ */
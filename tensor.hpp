@@ -0,0 +1,85 @@
+#ifndef TENSOR_HPP_
+#define TENSOR_HPP_
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Class for a batch of images stored as one contiguous NCHW buffer.
+ * @details image n, channel c is a compact height * width plane stored row by
+ *          row, the planes of one image follow each other and the images
+ *          follow each other, so a whole batch is a single allocation and a
+ *          plane can be passed to the pointer versions of ConvLayer::convolute
+ *          and ConvLayer::pooling without copying.
+ *
+ * @param[in] batch number of images (N)
+ * @param[in] channels number of channels per image (C)
+ * @param[in] height number of rows (H)
+ * @param[in] width number of pixels per row (W)
+ * @param[in] value initial value of every pixel
+ */
+template <typename T>
+class Tensor
+{
+public:
+    Tensor(void) {}
+    Tensor(const std::size_t batch, const std::size_t channels, const std::size_t height, const std::size_t width,
+           const T value = T())
+    {
+        this->resize(batch, channels, height, width, value);
+    }
+    ~Tensor() {}
+
+    /**
+     * @brief changes the size and sets every pixel to value
+     *
+     * @param[in] batch number of images
+     * @param[in] channels number of channels per image
+     * @param[in] height number of rows
+     * @param[in] width number of pixels per row
+     * @param[in] value new value of every pixel
+     */
+    void resize(const std::size_t batch, const std::size_t channels, const std::size_t height,
+                const std::size_t width, const T value = T())
+    {
+        this->batch_ = batch;
+        this->channels_ = channels;
+        this->height_ = height;
+        this->width_ = width;
+        this->data_.assign(batch * channels * height * width, value);
+    }
+
+    std::size_t batch(void) const { return this->batch_; }
+    std::size_t channels(void) const { return this->channels_; }
+    std::size_t height(void) const { return this->height_; }
+    std::size_t width(void) const { return this->width_; }
+    std::size_t plane_size(void) const { return this->height_ * this->width_; }
+    std::size_t size(void) const { return this->data_.size(); }
+    std::size_t bytes(void) const { return this->data_.size() * sizeof(T); }
+    T *plane(const std::size_t n, const std::size_t c)
+    {
+        return &this->data_[(n * this->channels_ + c) * this->plane_size()];
+    }
+    const T *plane(const std::size_t n, const std::size_t c) const
+    {
+        return &this->data_[(n * this->channels_ + c) * this->plane_size()];
+    }
+    T &operator()(const std::size_t n, const std::size_t c, const std::size_t y, const std::size_t x)
+    {
+        return this->plane(n, c)[y * this->width_ + x];
+    }
+    const T &operator()(const std::size_t n, const std::size_t c, const std::size_t y, const std::size_t x) const
+    {
+        return this->plane(n, c)[y * this->width_ + x];
+    }
+    const std::vector<T> &data(void) const { return this->data_; }
+
+private:
+    std::size_t batch_ = 0;
+    std::size_t channels_ = 0;
+    std::size_t height_ = 0;
+    std::size_t width_ = 0;
+    std::vector<T> data_;
+};
+
+#endif /* TENSOR_HPP_ */
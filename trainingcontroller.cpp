@@ -0,0 +1,184 @@
+#include "trainingcontroller.hpp"
+#include <iomanip>
+
+/**
+ * @brief Construct a new TrainingController::TrainingController object, the
+ *        validation split is kept by reference and must outlive the controller
+ *
+ * @param[in] inputs validation samples, one per row
+ * @param[in] targets validation references, one per row
+ * @param[in] config when to evaluate and when to stop
+ */
+TrainingController::TrainingController(const FeatureMap<double> &inputs,
+                                       const FeatureMap<double> &targets,
+                                       const Config &config)
+    : inputs_(inputs), targets_(targets), config_(config)
+{
+    if (this->config_.evaluate_every == 0)
+    {
+        this->config_.evaluate_every = 1;
+    }
+}
+
+/**
+ * @brief Construct a new TrainingController::TrainingController object with
+ *        the default Config
+ *
+ * @param[in] inputs validation samples, one per row
+ * @param[in] targets validation references, one per row
+ */
+TrainingController::TrainingController(const FeatureMap<double> &inputs,
+                                       const FeatureMap<double> &targets)
+    : TrainingController(inputs, targets, Config())
+{
+}
+
+/**
+ * @brief starts the clock and evaluates the untrained network, so the best
+ *        weights are never worse than the initial ones
+ *
+ * @param[in] network network about to be trained
+ */
+void TrainingController::begin(NeuralNetwork &network)
+{
+    this->report_ = Report();
+    this->history_.clear();
+    this->has_snapshot_ = false;
+    this->last_epoch_ = 0;
+    this->best_snapshot_.resize(network.snapshot_size());
+    this->start_ns_ = Profiler::now_ns();
+    this->evaluate(network, 0, 0.0);
+}
+
+/**
+ * @brief called after every epoch, evaluates the validation split when due
+ *
+ * @param[in] network network being trained
+ * @param[in] epoch number of completed epochs
+ * @param[in] train_loss mean squared error of the epoch
+ * @return true if training should stop
+ */
+bool TrainingController::end_epoch(NeuralNetwork &network, const std::size_t epoch, const double train_loss)
+{
+    this->last_epoch_ = epoch;
+    this->report_.epochs = epoch;
+    if (epoch % this->config_.evaluate_every != 0)
+    {
+        return false;
+    }
+    return this->evaluate(network, epoch, train_loss);
+}
+
+/**
+ * @brief restores the best weights (unless the last epoch was the best one)
+ *        and stops the clock
+ *
+ * @param[in] network network that was trained
+ */
+void TrainingController::finish(NeuralNetwork &network)
+{
+    if (this->config_.restore_best && this->has_snapshot_ && this->report_.best_epoch != this->last_epoch_)
+    {
+        std::size_t epoch = 0;
+        network.load_snapshot(this->best_snapshot_.data(), this->best_snapshot_.size(), epoch);
+    }
+    this->report_.seconds = (Profiler::now_ns() - this->start_ns_) * 1e-9;
+}
+
+/**
+ * @brief evaluates the validation split (or takes the training loss if the
+ *        split is empty), keeps the best weights and decides whether to stop
+ *
+ * @param[in] network network being trained
+ * @param[in] epoch number of completed epochs
+ * @param[in] train_loss mean squared error of the last epoch
+ * @return true if training should stop
+ */
+bool TrainingController::evaluate(NeuralNetwork &network, const std::size_t epoch, const double train_loss)
+{
+    Evaluation evaluation;
+    evaluation.epoch = epoch;
+    evaluation.train_loss = train_loss;
+    if (this->inputs_.height() > 0)
+    {
+        const EvaluationResult result = network.evaluate(this->inputs_, this->targets_);
+        this->report_.validation_seconds += result.seconds;
+        evaluation.validation_loss = result.loss;
+        evaluation.accuracy = result.accuracy;
+    }
+    else if (epoch > 0)
+    {
+        evaluation.validation_loss = train_loss;
+    }
+    else
+    {
+        return false;
+    }
+    evaluation.seconds = (Profiler::now_ns() - this->start_ns_) * 1e-9;
+    this->history_.push_back(evaluation);
+
+    const double loss = evaluation.validation_loss;
+    if (!this->has_snapshot_ || loss < this->report_.best_validation_loss - this->config_.min_delta)
+    {
+        network.save_snapshot(this->best_snapshot_.data(), epoch);
+        this->has_snapshot_ = true;
+        this->report_.best_epoch = epoch;
+        this->report_.best_validation_loss = loss;
+    }
+    if (this->config_.target_loss > 0.0 && loss <= this->config_.target_loss && this->report_.time_to_target < 0.0)
+    {
+        this->report_.time_to_target = evaluation.seconds;
+        this->report_.epochs_to_target = epoch;
+        if (this->config_.stop_at_target)
+        {
+            this->report_.reason = stop_reason::TARGET;
+            return true;
+        }
+    }
+    if (this->config_.patience > 0 && epoch - this->report_.best_epoch >= this->config_.patience)
+    {
+        this->report_.reason = stop_reason::PLATEAU;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief prints every validation pass and the report
+ *
+ * @param[in] ostream chosen output stream
+ */
+void TrainingController::print(std::ostream &ostream) const
+{
+    ostream << std::setfill(' ') << std::left << std::setw(8) << "epoch" << std::right << std::setw(14)
+            << "train loss" << std::setw(16) << "valid loss" << std::setw(12) << "accuracy" << std::setw(12)
+            << "seconds" << "\n";
+    for (const auto &evaluation : this->history_)
+    {
+        ostream << std::left << std::setw(8) << evaluation.epoch << std::right << std::setw(14);
+        if (evaluation.epoch == 0)
+        {
+            ostream << "-";
+        }
+        else
+        {
+            ostream << evaluation.train_loss;
+        }
+        ostream << std::setw(16) << evaluation.validation_loss << std::setw(12)
+                << evaluation.accuracy << std::setw(12) << evaluation.seconds
+                << (evaluation.epoch == this->report_.best_epoch ? "  best" : "") << "\n";
+    }
+    const Report &report = this->report_;
+    ostream << "stopped after " << report.epochs << " epochs ("
+            << (report.reason == stop_reason::TARGET    ? "target reached"
+                : report.reason == stop_reason::PLATEAU ? "plateau"
+                                                        : "epoch limit")
+            << ") in " << report.seconds << " s, " << report.validation_seconds << " s validating, best epoch "
+            << report.best_epoch << " (loss " << report.best_validation_loss << ")";
+    if (report.time_to_target >= 0.0)
+    {
+        ostream << ", target " << this->config_.target_loss << " reached at epoch " << report.epochs_to_target
+                << " after " << report.time_to_target << " s";
+    }
+    ostream << "\n";
+}
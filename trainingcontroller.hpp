@@ -0,0 +1,111 @@
+#ifndef TRAININGCONTROLLER_HPP_
+#define TRAININGCONTROLLER_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+
+#include "neuralnetwork.hpp"
+
+/**
+ * @brief why a controlled training run ended
+ */
+enum class stop_reason
+{
+    EPOCHS,
+    PLATEAU,
+    TARGET
+};
+
+/**
+ * @brief Class for stopping training when it no longer pays off.
+ * @details network.train(epochs, lr, controller) reports the mean squared
+ *          error of every epoch, summed from the output errors the backward
+ *          pass computes anyway, so the training loss costs nothing extra.
+ *          Every evaluate_every epochs the validation split is run through
+ *          NeuralNetwork::evaluate (one batched forward pass). The weights
+ *          with the lowest validation loss so far are kept as an in-memory
+ *          snapshot (NeuralNetwork::save_snapshot, preallocated once).
+ *
+ *          Training stops when the validation loss has not improved by more
+ *          than min_delta for patience epochs, or when it reaches target_loss
+ *          (if stop_at_target is set), and the best weights are restored.
+ *          The time and epochs until the validation loss first reached
+ *          target_loss are reported either way.
+ *
+ * @param[in] inputs validation samples, one per row
+ * @param[in] targets validation references, one per row
+ */
+class TrainingController
+{
+public:
+    /**
+     * @brief when to evaluate and when to stop, target_loss 0 disables the target
+     */
+    struct Config
+    {
+        std::size_t evaluate_every = 1;
+        std::size_t patience = 10;
+        double min_delta = 0.0;
+        double target_loss = 0.0;
+        bool stop_at_target = true;
+        bool restore_best = true;
+    };
+
+    /**
+     * @brief one validation pass, train_loss is the mean of the last epoch
+     */
+    struct Evaluation
+    {
+        std::size_t epoch = 0;
+        double train_loss = 0.0;
+        double validation_loss = 0.0;
+        double accuracy = 0.0;
+        double seconds = 0.0;
+    };
+
+    /**
+     * @brief result of the run, time_to_target and epochs_to_target are
+     *        negative / 0 if the target was never reached
+     */
+    struct Report
+    {
+        stop_reason reason = stop_reason::EPOCHS;
+        std::size_t epochs = 0;
+        std::size_t best_epoch = 0;
+        double best_validation_loss = 0.0;
+        double seconds = 0.0;
+        double validation_seconds = 0.0;
+        double time_to_target = -1.0;
+        std::size_t epochs_to_target = 0;
+    };
+
+    TrainingController(const FeatureMap<double> &inputs,
+                       const FeatureMap<double> &targets,
+                       const Config &config);
+    TrainingController(const FeatureMap<double> &inputs,
+                       const FeatureMap<double> &targets);
+    ~TrainingController() {}
+    void begin(NeuralNetwork &network);
+    bool end_epoch(NeuralNetwork &network, const std::size_t epoch, const double train_loss);
+    void finish(NeuralNetwork &network);
+    const Report &report(void) const { return this->report_; }
+    const std::vector<Evaluation> &history(void) const { return this->history_; }
+    void print(std::ostream &ostream = std::cout) const;
+
+private:
+    const FeatureMap<double> &inputs_;
+    const FeatureMap<double> &targets_;
+    Config config_;
+    Report report_;
+    std::vector<Evaluation> history_;
+    std::vector<char> best_snapshot_;
+    bool has_snapshot_ = false;
+    std::size_t last_epoch_ = 0;
+    uint64_t start_ns_ = 0;
+
+    bool evaluate(NeuralNetwork &network, const std::size_t epoch, const double train_loss);
+};
+
+#endif /* TRAININGCONTROLLER_HPP_ */